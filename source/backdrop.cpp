@@ -1,7 +1,7 @@
 #include "backdrop.h"
 #include "image.h"
 
-Backdrop::Backdrop(const Image *img, const Vec2f &pos, int f, float a, float sx, float sy, bool fh, bool fv) :
+Backdrop::Backdrop(const Image *img, const Vec2f &pos, int f, float a, float sx, float sy, bool fh, bool fv, int o) :
   image(img),
   position(pos),
   frame(f),
@@ -9,7 +9,8 @@ Backdrop::Backdrop(const Image *img, const Vec2f &pos, int f, float a, float sx,
   scaleX(sx),
   scaleY(sy),
   flipH(fh),
-  flipV(fv) {}
+  flipV(fv),
+  order(o) {}
 
 void Backdrop::draw(float scrollFactor) const
 {
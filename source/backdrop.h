@@ -9,7 +9,7 @@ class XMLTag;
 class Backdrop
 {
  public:
-  Backdrop(const Image*, const Vec2f &pos, int f, float angle, float sx, float sy, bool fh, bool fv);
+  Backdrop(const Image*, const Vec2f &pos, int f, float angle, float sx, float sy, bool fh, bool fv, int o = 0);
   ~Backdrop() {}
 
   void draw(float scrollFactor) const;
@@ -32,6 +32,9 @@ class Backdrop
   const Image *getImage() const { return image; }
   int getFrame() const { return frame; }
 
+  // Where it goes in its layer's drawing order, for scenes placed out of order
+  int getOrder() const { return order; }
+
   Backdrop(const Backdrop&) = delete;
   Backdrop &operator=(const Backdrop&) = delete;
   
@@ -42,6 +45,7 @@ class Backdrop
   float angle;
   float scaleX, scaleY;
   bool flipH, flipV;
+  int order;
 };
 
 #endif
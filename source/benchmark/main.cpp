@@ -0,0 +1,181 @@
+// Headless stress test for swept box collision. Throws a crowd of actor sized
+// boxes around a closed room full of thin platforms at high speeds and low
+// frame rates, and counts how many of them end up outside of the room (which
+// would mean they went through a wall).
+//
+// After that it times the plain queries on their own: the short rays and box
+// sweeps actors do every frame, without any of the bouncing around, and the
+// long rays enemies look with. Those run once through the segment BVH and
+// once walking the grid, which should find the same hits.
+//
+//   make bench && ./bench [boxes] [seconds]
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+
+#include "physicsmanager.h"
+
+namespace {
+
+const float WORLD_W = 8192, WORLD_H = 4096;
+const float HALF_WIDTH = 32, HEIGHT = 128;
+const float MAX_SPEED = 16000;
+
+struct Box
+{
+  Box() : pos(), vel() {}
+  Vec2f pos, vel;
+};
+
+// Adds a wall in pieces, the way the backdrops split up their collision
+void addWall(PhysicsManager &physics, const Vec2f &a, const Vec2f &b)
+{
+  int pieces = std::ceil((b-a).length() / 256);
+  for (int i = 0; i < pieces; i++)
+    physics.addWorldSegment(a + (b-a) * (float(i)/pieces), a + (b-a) * (float(i+1)/pieces));
+}
+
+// Walls face inwards, platforms face up
+void buildRoom(PhysicsManager &physics)
+{
+  physics.resizeWorld(WORLD_W, WORLD_H);
+
+  const float m = 64;
+  addWall(physics, Vec2f(m, WORLD_H-m), Vec2f(WORLD_W-m, WORLD_H-m)); // floor
+  addWall(physics, Vec2f(WORLD_W-m, WORLD_H-m), Vec2f(WORLD_W-m, m)); // right wall
+  addWall(physics, Vec2f(WORLD_W-m, m), Vec2f(m, m));                 // ceiling
+  addWall(physics, Vec2f(m, m), Vec2f(m, WORLD_H-m));                 // left wall
+
+  for (int i = 0; i < 40; i++) {
+    float x = 256 + drand48() * (WORLD_W - 1024), y = 512 + drand48() * (WORLD_H - 1024);
+    physics.addWorldSegment(Vec2f(x, y), Vec2f(x + 128 + drand48()*384, y));
+  }
+}
+
+bool inside(const Vec2f &p)
+{
+  return p[0] > 64 && p[0] < WORLD_W-64 && p[1] > 64 && p[1] < WORLD_H-64;
+}
+
+// The same corner picking the actors do in the air
+PhysicsManager::RayResult sweep(PhysicsManager &physics, const Box &b, const Vec2f &dir)
+{
+  static const std::vector<Vec2f> corners = {
+    Vec2f(-HALF_WIDTH, -HEIGHT), Vec2f(-HALF_WIDTH, 0), Vec2f(HALF_WIDTH, 0), Vec2f(HALF_WIDTH, -HEIGHT) };
+  float e = PhysicsManager::EPSILON;
+  bool r = dir[0] > e, l = dir[0] < -e, u = dir[1] < -e, d = dir[1] > e;
+  bool straight = (r || l) ^ (u || d);
+
+  int count = 3-straight;
+  int start = (d && !l) + (r && !d)*2 + (u && !r)*3;
+  std::vector<Vec2f> points(count);
+  for (int i = 0; i < count; i++)
+    points[i] = b.pos + corners[ (start+i)%4 ];
+  return physics.multiPlaneCast(PhysicsManager::MASK_WORLD, dir, points);
+}
+
+void run(PhysicsManager &physics, int count, float seconds, float delta)
+{
+  std::vector<Box> boxes(count);
+  for (Box &b : boxes) {
+    b.pos = Vec2f(512 + drand48()*(WORLD_W-1024), 512 + drand48()*(WORLD_H-1024));
+    b.vel = Vec2f((drand48()*2-1) * MAX_SPEED, (drand48()*2-1) * MAX_SPEED);
+  }
+
+  long sweeps = 0, contacts = 0;
+  auto begin = std::chrono::steady_clock::now();
+
+  for (float time = 0.f; time < seconds; time += delta) {
+    for (Box &b : boxes) {
+      b.vel[1] += PhysicsManager::GRAVITY * delta;
+      Vec2f dir = b.vel * delta;
+
+      // Bounce off of up to four surfaces, then stop at the last one
+      for (int c = 0; c < 4 && dir.lengthSquared() > PhysicsManager::EPSILON; c++) {
+	PhysicsManager::RayResult result = sweep(physics, b, dir);
+	sweeps++;
+	if (!result.hit) break;
+	contacts++;
+	if (c == 3) {
+	  dir = PhysicsManager::rayStop(dir, -dir.normalize(), result.t);
+	  break;
+	}
+	dir = PhysicsManager::raySlide(dir, result.normal, result.t);
+	b.vel = b.vel - result.normal * b.vel.dot(result.normal) * 1.8f;
+      }
+      b.pos += dir;
+    }
+  }
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+  int escaped = 0;
+  for (const Box &b : boxes) escaped += !inside(b.pos);
+
+  std::cout << "  " << 1.f/delta << " fps: "
+	    << sweeps << " sweeps, " << contacts << " contacts, "
+	    << (sweeps ? elapsed * 1000.0 / sweeps : 0.0) << " ns/sweep, "
+	    << escaped << " of " << count << " tunneled out" << std::endl;
+}
+
+// Times a query over the same random short moves the actors make in a frame
+// (or longer ones, scaled up)
+template <typename F>
+void timeQuery(const char *name, int count, float scale, F &&query)
+{
+  srand48(2);
+  std::vector<Vec2f> from(count), dir(count);
+  for (int i = 0; i < count; i++) {
+    from[i] = Vec2f(256 + drand48()*(WORLD_W-512), 256 + drand48()*(WORLD_H-512));
+    dir[i] = Vec2f((drand48()*2-1) * 64, (drand48()*2-1) * 64) * scale;
+  }
+
+  int hits = 0;
+  auto begin = std::chrono::steady_clock::now();
+  for (int pass = 0; pass < 20; pass++)
+    for (int i = 0; i < count; i++) hits += query(from[i], dir[i]);
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+
+  std::cout << "  " << name << ": " << elapsed * 1000.0 / (count*20) << " ns/query (" << hits << " hits)" << std::endl;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    int count = argc > 1 ? atoi(argv[1]) : 500;
+    float seconds = argc > 2 ? atof(argv[2]) : 10.f;
+
+    srand48(1);
+    PhysicsManager &physics = PhysicsManager::getInstance();
+    buildRoom(physics);
+
+    std::cout << count << " boxes for " << seconds << " seconds at up to " << MAX_SPEED << " px/s" << std::endl;
+    for (float fps : {120.f, 60.f, 30.f, 15.f, 8.f, 4.f})
+      run(physics, count, seconds, 1.f/fps);
+
+    for (bool bvh : {true, false}) {
+      physics.setUseBVH(bvh);
+      std::cout << "Queries (" << (bvh ? "BVH" : "grid") << ")" << std::endl;
+      timeQuery("rayCast", 100000, 1.f, [&physics](const Vec2f &a, const Vec2f &d) {
+	  return physics.rayCast(PhysicsManager::MASK_WORLD, a, a + d).hit; });
+      timeQuery("rayCast x64", 100000, 64.f, [&physics](const Vec2f &a, const Vec2f &d) {
+	  return physics.rayCast(PhysicsManager::MASK_WORLD, a, a + d).hit; });
+      timeQuery("multiPlaneCast", 100000, 1.f, [&physics](const Vec2f &a, const Vec2f &d) {
+	  Box b;
+	  b.pos = a;
+	  return sweep(physics, b, d).hit; });
+      timeQuery("lineOfSight x8", 100000, 8.f, [&physics](const Vec2f &a, const Vec2f &d) {
+	  return !physics.lineOfSight(a, a + d); });
+      timeQuery("lineOfSight x64", 100000, 64.f, [&physics](const Vec2f &a, const Vec2f &d) {
+	  return !physics.lineOfSight(a, a + d); });
+    }
+    physics.setUseBVH(true);
+    timeQuery("nearestSegment", 100000, 1.f, [&physics](const Vec2f &a, const Vec2f &) {
+	return physics.nearestSegment(a, 256.f) != nullptr; });
+  }
+  catch (const std::string& msg) { std::cout << msg << std::endl; return 1; }
+  return 0;
+}
@@ -0,0 +1,107 @@
+#ifndef BINARYIO_H
+#define BINARYIO_H
+
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+
+#include "vector2.h"
+
+// Little-endian binary files, for replays, save games and compiled scenes. Both throw a
+// std::string if the file can't be opened or (when reading) runs out early.
+
+class BinaryWriter
+{
+ public:
+  BinaryWriter(const std::string &f, const char magic[4]) : file(f), out(f, std::ios::binary) {
+    if (!out.is_open()) throw std::string("Couldn't write " + file);
+    out.write(magic, 4);
+  }
+
+  void put(uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) out.put(static_cast<char>((v >> (i*8)) & 0xff));
+  }
+
+  void putFloat(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(float));
+    put(bits, 4);
+  }
+
+  void putVec(const Vec2f &v) { putFloat(v[0]); putFloat(v[1]); }
+  void putString(const std::string &s) { put(s.size(), 2); out.write(s.data(), s.size()); }
+
+  // For going back to fill in offsets once they're known
+  uint64_t tell() { return out.tellp(); }
+  void seek(uint64_t pos) { out.seekp(pos); }
+
+  // Closes the file, throwing if anything along the way didn't make it to disk
+  void finish() {
+    out.close();
+    if (out.fail()) throw std::string("Couldn't finish writing " + file);
+  }
+
+  BinaryWriter(const BinaryWriter&) = delete;
+  BinaryWriter &operator=(const BinaryWriter&) = delete;
+
+ private:
+  std::string file;
+  std::ofstream out;
+};
+
+class BinaryReader
+{
+ public:
+  BinaryReader(const std::string &f, const char magic[4]) : file(f), in(f, std::ios::binary) {
+    if (!in.is_open()) throw std::string("Couldn't open " + file);
+    char m[4];
+    if (!in.read(m, 4) || memcmp(m, magic, 4) != 0)
+      throw std::string(file + " isn't a " + std::string(magic, 4) + " file");
+  }
+
+  uint64_t get(int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) {
+      int c = in.get();
+      if (c == EOF) throw std::string(file + " is cut short");
+      v |= static_cast<uint64_t>(c) << (i*8);
+    }
+    return v;
+  }
+
+  // Signed values written with put(v, bytes)
+  int getInt(int bytes) {
+    uint64_t v = get(bytes);
+    if (bytes < 8 && (v >> (bytes*8-1)) & 1) v |= ~0ULL << (bytes*8);
+    return static_cast<int>(static_cast<int64_t>(v));
+  }
+
+  float getFloat() {
+    uint32_t bits = get(4);
+    float f;
+    memcpy(&f, &bits, sizeof(float));
+    return f;
+  }
+
+  Vec2f getVec() { float x = getFloat(); return Vec2f(x, getFloat()); }
+
+  std::string getString() {
+    std::string s(get(2), '\0');
+    if (!in.read(&s[0], s.size())) throw std::string(file + " is cut short");
+    return s;
+  }
+
+  void seek(uint64_t pos) {
+    if (!in.seekg(pos)) throw std::string(file + " is cut short");
+  }
+
+  BinaryReader(const BinaryReader&) = delete;
+  BinaryReader &operator=(const BinaryReader&) = delete;
+
+ private:
+  std::string file;
+  std::ifstream in;
+};
+
+#endif
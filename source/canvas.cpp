@@ -3,6 +3,10 @@
 #include "image.h"
 #include "viewport.h"
 
+#include <iterator>
+
+#include "entity/chunkexplosion.h"
+
 Canvas::Canvas() : layers()
 {
   layers[0];
@@ -93,6 +97,8 @@ void Canvas::draw() const
     }
     for (const Entity *e : l.second.entities)
       e->draw( scroll );
+    if (l.first == LAYER_MAIN)
+      ChunkManager::getInstance().draw( scroll );
     for (const Backdrop &b : l.second.backdrops)
       b.draw( scroll );
   }
@@ -104,6 +110,22 @@ Backdrop *Canvas::placeBackdrop(int layerID, const Image* img, const Vec2f &posi
   return &layers[layerID].backdrops.back();
 }
 
+Backdrop *Canvas::placeBackdrop(int layerID, int order, const Image* img, const Vec2f &position, int frame, float angle, float scaleX, float scaleY, bool flipH, bool flipV)
+{
+  // Usually goes near the end, so look from there
+  std::list<Backdrop> &list = layers[layerID].backdrops;
+  auto it = list.end();
+  while (it != list.begin() && std::prev(it)->getOrder() > order) --it;
+  return &*list.emplace( it, img, position, frame, angle, scaleX, scaleY, flipH, flipV, order );
+}
+
+void Canvas::removeBackdrops(int layerID, const std::unordered_set<const Backdrop*> &backdrops)
+{
+  auto l = layers.find(layerID);
+  if (l == layers.end()) return;
+  l->second.backdrops.remove_if([&backdrops](const Backdrop &b) { return backdrops.count(&b) > 0; });
+}
+
 void Canvas::updateEntityList()
 {
   for (auto &l : layers) {
@@ -4,6 +4,7 @@
 #include <list>
 #include <map>
 #include <vector>
+#include <unordered_set>
 
 #include "vector2.h"
 #include "backdrop.h"
@@ -50,6 +51,11 @@ class Canvas
   Backdrop *placeBackdrop(int layerID, const Image*, const Vec2f &position, int frame, float angle, float scaleX, float scaleY, bool flipH, bool flipV);
   std::list<Backdrop> &getBackdropList(int layerID) { return layers[layerID].backdrops; }
 
+  // Same, but slotted in by order rather than at the end, since streamed
+  // scenes don't place them in the order they're drawn
+  Backdrop *placeBackdrop(int layerID, int order, const Image*, const Vec2f &position, int frame, float angle, float scaleX, float scaleY, bool flipH, bool flipV);
+  void removeBackdrops(int layerID, const std::unordered_set<const Backdrop*>&);
+
   // (usually just for the backmost layer (is that a word??))
   void setBackground(int layerID, const Image* img) { layers[layerID].background = img; }
   const Image *getBackground(int layerID) const { return layers.at(layerID).background; }
@@ -0,0 +1,163 @@
+#ifndef CELLMAP_H
+#define CELLMAP_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+// A cell of a grid, by column and row. Either can be negative.
+struct CellKey
+{
+  int x, y;
+
+  bool operator==(const CellKey &o) const { return x == o.x && y == o.y; }
+  bool operator!=(const CellKey &o) const { return !(*this == o); }
+
+  // Row by row, so sorting by cell keeps neighbours in a row together
+  bool operator<(const CellKey &o) const { return y < o.y || (y == o.y && x < o.x); }
+};
+
+/*
+ * Grid cells by their coordinates, for grids that are mostly empty. Only
+ * cells that have been asked for exist, so the size of the grid costs nothing.
+ *
+ * Open addressing with linear probing in a power of two sized table. Erased
+ * cells leave a marker behind (so probing past them still works, and cells
+ * can be erased while going through them with forEach), and the markers go
+ * away whenever the table gets rebuilt.
+ *
+ * Adding a cell may rebuild the table, which moves every value (so pointers
+ * to values don't last, but whatever values own on the heap does).
+ */
+template <typename T>
+class CellMap
+{
+ public:
+  CellMap() : slots(), count(0), erased(0) {}
+
+  T *find(const CellKey &key) {
+    int i = findSlot(key);
+    return i < 0 ? nullptr : &slots[i].value; }
+  const T *find(const CellKey &key) const {
+    int i = findSlot(key);
+    return i < 0 ? nullptr : &slots[i].value; }
+
+  // The cell, made empty if it isn't there yet
+  T &operator[](const CellKey &key);
+
+  void erase(const CellKey &key);
+  void clear() { slots.clear(); count = erased = 0; }
+
+  // Calls f(key, value) for every cell. The current cell may be erased, but
+  // none may be added until it's done.
+  template <typename F>
+  void forEach(F &&f) {
+    for (Slot &s : slots) if (s.state == SLOT_FULL) f(static_cast<const CellKey&>(s.key), s.value); }
+  template <typename F>
+  void forEach(F &&f) const {
+    for (const Slot &s : slots) if (s.state == SLOT_FULL) f(s.key, s.value); }
+
+  int size() const { return count; }
+  int getCapacity() const { return slots.size(); }
+  int getErasedCount() const { return erased; }
+
+  // Bytes in the table itself, not counting what the values hold on to
+  size_t getMemoryUsage() const { return slots.capacity() * sizeof(Slot); }
+
+ private:
+  enum SlotState : unsigned char
+  {
+    SLOT_EMPTY,
+    SLOT_FULL,
+    SLOT_ERASED
+  };
+
+  struct Slot
+  {
+    Slot() : key{0, 0}, state(SLOT_EMPTY), value() {}
+    CellKey key;
+    SlotState state;
+    T value;
+  };
+
+  std::vector<Slot> slots;
+  int count, erased;
+
+  static uint64_t hash(const CellKey &k) {
+    uint64_t h = static_cast<uint32_t>(k.x) * 0x9E3779B97F4A7C15ULL ^ static_cast<uint32_t>(k.y) * 0xC2B2AE3D27D4EB4FULL;
+    return h ^ (h >> 29);
+  }
+
+  int findSlot(const CellKey &key) const;
+  void rebuild(int capacity);
+};
+
+template <typename T>
+int CellMap<T>::findSlot(const CellKey &key) const
+{
+  if (slots.empty()) return -1;
+  size_t mask = slots.size() - 1;
+  for (size_t i = hash(key) & mask;; i = (i+1) & mask) {
+    const Slot &s = slots[i];
+    if (s.state == SLOT_EMPTY) return -1;
+    if (s.state == SLOT_FULL && s.key == key) return i;
+  }
+}
+
+template <typename T>
+T &CellMap<T>::operator[](const CellKey &key)
+{
+  int found = findSlot(key);
+  if (found >= 0) return slots[found].value;
+
+  // Keep at least a quarter of the table empty, so probes stay short
+  if ((count + erased + 1) * 4 > static_cast<int>(slots.size()) * 3) {
+    int capacity = 16;
+    while (capacity < (count + 1) * 2) capacity *= 2;
+    rebuild(capacity);
+  }
+
+  // Reuse the first erased slot on the way, if there was one
+  size_t mask = slots.size() - 1, i = hash(key) & mask;
+  while (slots[i].state == SLOT_FULL) i = (i+1) & mask;
+  if (slots[i].state == SLOT_ERASED) erased--;
+
+  Slot &s = slots[i];
+  s.key = key;
+  s.state = SLOT_FULL;
+  count++;
+  return s.value;
+}
+
+template <typename T>
+void CellMap<T>::erase(const CellKey &key)
+{
+  int i = findSlot(key);
+  if (i < 0) return;
+  slots[i].state = SLOT_ERASED;
+  slots[i].value = T();
+  count--;
+  erased++;
+}
+
+template <typename T>
+void CellMap<T>::rebuild(int capacity)
+{
+  std::vector<Slot> old(capacity);
+  old.swap(slots);
+  count = erased = 0;
+
+  size_t mask = slots.size() - 1;
+  for (Slot &o : old) {
+    if (o.state != SLOT_FULL) continue;
+    size_t i = hash(o.key) & mask;
+    while (slots[i].state == SLOT_FULL) i = (i+1) & mask;
+    slots[i].key = o.key;
+    slots[i].state = SLOT_FULL;
+    slots[i].value = std::move(o.value);
+    count++;
+  }
+}
+
+#endif
@@ -4,29 +4,24 @@
 #include "gameconfig.h"
 
 DebugHUD::DebugHUD() :
-  messages(), visible(false),
-  tr(), tg(), tb(), ta(),
-  br(), bg(), bb(), ba(),
-  lr(), lg(), lb(), la()
+  messages(), lines(), visible(false),
+  settings(GameConfig::getInstance().get().debug),
+  refreshTimer(0.f)
+{}
+
+void DebugHUD::update(float delta)
 {
-  const XMLTag &debug = GameConfig::getInstance()["debug"];
-  tr = debug["textColor"]["r"].toInt();
-  tg = debug["textColor"]["g"].toInt();
-  tb = debug["textColor"]["b"].toInt();
-  ta = debug["textColor"]["a"].toInt();
-  br = debug["backColor"]["r"].toInt();
-  bg = debug["backColor"]["g"].toInt();
-  bb = debug["backColor"]["b"].toInt();
-  ba = debug["backColor"]["a"].toInt();
-  lr = debug["outlineColor"]["r"].toInt();
-  lg = debug["outlineColor"]["g"].toInt();
-  lb = debug["outlineColor"]["b"].toInt();
-  la = debug["outlineColor"]["a"].toInt();
+  if (!visible) return;
+  refreshTimer -= delta;
+  if (refreshTimer > 0.f) return;
+  refreshTimer = 1.f / settings.refreshRate;
+
+  for (auto &p : lines) messages[p.first] = p.second();
 }
 
 void DebugHUD::draw() const
 {
-  if (!visible) return;
+  if (!visible || messages.empty()) return;
 
   int count = messages.rbegin()->first + 1;
   
@@ -35,11 +30,12 @@ void DebugHUD::draw() const
   SDL_Rect area = { 15, 35, 600, static_cast<int>(30 + count * 30) };
   
   SDL_SetRenderDrawBlendMode( renderer, SDL_BLENDMODE_BLEND );
-  SDL_SetRenderDrawColor( renderer, br, bg, bb, ba );
+  const Settings::Color &back = settings.backColor, &line = settings.outlineColor, &text = settings.textColor;
+  SDL_SetRenderDrawColor( renderer, back.r, back.g, back.b, back.a );
   SDL_RenderFillRect( renderer, &area );
-  SDL_SetRenderDrawColor( renderer, lr, lg, lb, la );
+  SDL_SetRenderDrawColor( renderer, line.r, line.g, line.b, line.a );
   SDL_RenderDrawRect( renderer, &area );
   
   for (auto &p : messages)
-    IoMod::getInstance().writeText(p.second, 30, 50 + p.first * 30, {(Uint8)tr, (Uint8)tg, (Uint8)tb, (Uint8)ta} );
+    IoMod::getInstance().writeText(p.second, 30, 50 + p.first * 30, {(Uint8)text.r, (Uint8)text.g, (Uint8)text.b, (Uint8)text.a} );
 }
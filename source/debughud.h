@@ -3,6 +3,9 @@
 
 #include <string>
 #include <map>
+#include <functional>
+
+#include "gameconfig.h"
 
 class DebugHUD
 {
@@ -10,18 +13,27 @@ class DebugHUD
   DebugHUD();
   ~DebugHUD() {}
 
+  // Reformats the lines, but only while the HUD is showing and at most
+  // refreshRate times a second
+  void update(float delta);
   void draw() const;
 
+  // A line that never changes
   void setMessage(int lineID, const std::string& msg) { messages[lineID] = msg; }
-  void toggle() { visible = !visible; }
+
+  // A line that is made when it's about to be seen
+  void setLine(int lineID, std::function<std::string()> &&format) { lines[lineID] = std::move(format); }
+
+  void toggle() { visible = !visible; refreshTimer = 0.f; }
   
  private:
   std::map<int, std::string> messages;
+  std::map<int, std::function<std::string()> > lines;
   bool visible;
 
-  int tr, tg, tb, ta;
-  int br, bg, bb, ba;
-  int lr, lg, lb, la;
+  // Colors and refresh rate
+  const Settings::Debug &settings;
+  float refreshTimer;
 };
 
 #endif
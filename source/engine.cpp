@@ -6,8 +6,15 @@
 #include "viewport.h"
 #include "appstatemanager.h"
 #include "gameconfig.h"
+#include "soundmanager.h"
+#include "random.h"
+#include "replay.h"
+#include "scenestreamer.h"
 
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
 #include <SDL.h>
 
 Engine::~Engine()
@@ -30,6 +37,7 @@ void Engine::update(float delta)
 {
   appmgr.stateUpdate(delta);
   viewport.update(delta);
+  SoundManager::getInstance().update();
 }
 
 void Engine::draw() const
@@ -45,12 +53,30 @@ void Engine::draw() const
 
 void Engine::play(AppState *state)
 {
-  GameConfig &cfg = GameConfig::getInstance();
-  SDL_Event event;
+  run(state, nullptr);
+}
 
-  // Get some properties about the screen frame rate
-  int frameCap = cfg["frameCap"].toInt();
-  bool vsync = cfg["vsync"].toBool();
+void Engine::record(AppState *state, const std::string &file)
+{
+  // Start over from the seed in case anything drew numbers while loading
+  Random &random = Random::getInstance();
+  random.seed(random.getSeed());
+
+  // Regions (and the enemies in them) have to come in on the same frames when played back
+  SceneStreamer::getInstance().setSynchronous(true);
+
+  Replay recording;
+  recording.begin(random.getSeed());
+  run(state, &recording);
+  recording.save(file);
+  std::cout << "Saved " << recording.getFrames().size() << " frames to " << file << std::endl;
+}
+
+void Engine::run(AppState *state, Replay *recording)
+{
+  // The frame cap settings are live, so they're looked at every time
+  const Settings &cfg = GameConfig::getInstance().get();
+  SDL_Event event;
 
   // Now begin the app state to start running
   appmgr.changeState(state);
@@ -68,7 +94,7 @@ void Engine::play(AppState *state)
     clock.updateDelta();
 
     // Ignore framecap if VSync is on (find a fix later to have both)
-    if ( vsync || clock.getFPS() <= frameCap ) {
+    if ( cfg.vsync || !cfg.frameCapOn || clock.getFPS() <= cfg.frameCap ) {
       // Create a new starting point in time to calculate delta from
       clock.incrementTime();
 
@@ -87,13 +113,22 @@ void Engine::play(AppState *state)
 	  }
 	}
 
+	if (recording != nullptr && (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP))
+	  recording->addKey(event.key.keysym.scancode, event.type == SDL_KEYDOWN, event.key.repeat != 0);
+
 	// Aside from the "super" options, input into the current game state
 	// for the main input handling
 	appmgr.stateInput(event);
       }
 
       // Update the engine only if we are not paused
-      if (!paused) update(clock.getDelta());
+      if (!paused) {
+	update(clock.getDelta());
+	if (recording != nullptr) recording->endFrame(clock.getDelta());
+      }
+
+      // Not while recording, since what gets played back doesn't reload
+      if (recording == nullptr) GameConfig::getInstance().update(clock.getDelta());
 
       draw();
     }
@@ -102,3 +137,58 @@ void Engine::play(AppState *state)
   // End the current state at the end of the loop
   appmgr.stateEnd();
 }
+
+void Engine::replay(AppState *state, const std::string &file, const std::string &timingFile)
+{
+  Replay session;
+  session.load(file);
+  const std::vector<Replay::Frame> &frames = session.getFrames();
+
+  Random::getInstance().seed(session.getSeed());
+  SceneStreamer::getInstance().setSynchronous(true);
+  appmgr.changeState(state);
+
+  std::vector<double> times;
+  times.reserve(frames.size());
+
+  for (const Replay::Frame &frame : frames) {
+    // Keep the window responsive, but the only input comes from the replay
+    SDL_PumpEvents();
+    SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+
+    for (const Replay::Key &key : frame.keys) {
+      SDL_Event event{};
+      event.type = key.down ? SDL_KEYDOWN : SDL_KEYUP;
+      event.key.keysym.scancode = static_cast<SDL_Scancode>(key.scancode);
+      event.key.repeat = key.repeat;
+      appmgr.stateInput(event);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    update(frame.delta);
+    times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+    if (!rc.isHeadless()) draw();
+  }
+
+  appmgr.stateEnd();
+
+  if (!timingFile.empty()) {
+    std::ofstream out(timingFile);
+    if (!out.is_open()) throw std::string("Couldn't write timing to " + timingFile);
+    out << "frame,delta,update_ms" << std::endl;
+    for (size_t i = 0; i < times.size(); i++)
+      out << i << "," << frames[i].delta << "," << times[i] << std::endl;
+  }
+
+  if (times.empty()) return;
+  double total = 0.;
+  for (double t : times) total += t;
+  std::vector<double> sorted(times);
+  std::sort(sorted.begin(), sorted.end());
+  auto percentile = [&sorted](double p) { return sorted[std::min(sorted.size()-1, static_cast<size_t>(p * sorted.size()))]; };
+
+  std::cout << "Replayed " << times.size() << " frames of " << file << " in " << total << "ms" << std::endl
+	    << "  update ms: mean " << total / times.size() << ", median " << percentile(.5)
+	    << ", p95 " << percentile(.95) << ", p99 " << percentile(.99) << ", max " << sorted.back() << std::endl;
+}
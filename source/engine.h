@@ -1,6 +1,8 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
+#include <string>
+
 class SDL_Renderer;
 
 class RenderContext;
@@ -9,6 +11,7 @@ class Clock;
 class Viewport;
 class AppState;
 class AppStateManager;
+class Replay;
 
 class Engine {
 public:
@@ -18,6 +21,14 @@ public:
   // Start the application under a specific AppState
   void play(AppState*);
 
+  // Plays like normal, and saves the session as a replay when it ends
+  void record(AppState*, const std::string &file);
+
+  // Plays a recorded session back as fast as possible, drawing only if there
+  // is a window to see it in. Writes how long every frame's update took to
+  // timingFile (unless it's empty) and prints a summary at the end.
+  void replay(AppState*, const std::string &file, const std::string &timingFile);
+
   Engine(const Engine&) = delete;
   Engine &operator=(const Engine&) = delete;
 
@@ -32,6 +43,7 @@ private:
 
   void draw() const;
   void update(float delta);
+  void run(AppState*, Replay *recording);
 };
 
 #endif
@@ -39,6 +39,10 @@ class Entity
   virtual void registerEntityCollision(Entity*) {}
   virtual void registerHitBoxCollision(const HitBox*) {}
 
+  // Finer test after a circle already touches the bounding box. Entities
+  // without a better shape than their box just say yes.
+  virtual bool shapeCircleIntersection(const Vec2f &, float) const { return true; }
+
   void setPosition(const Vec2f &pos) { position = pos; }
   void setX(float x) { position[0] = x; }
   void setY(float y) { position[1] = y; }
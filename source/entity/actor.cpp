@@ -1,24 +1,21 @@
 #include "actor.h"
 #include "actormodel.h"
 #include "playercontroller.h"
+#include "chunkexplosion.h"
 
 #include "../physicsmanager.h"
+#include "../navgraph.h"
 #include "../image.h"
+#include "../viewport.h"
+#include "../gameconfig.h"
+#include "../random.h"
 
 std::map<int,int> Actor::maskCounts = std::map<int,int>();
-
-const std::vector<std::string> ANIM_MAP =
-  { "idle", // ANIM_IDLE
-    "walk", // ANIM_WALK
-    "run",  // ANIM_RUN
-    "jump", // ANIM_JUMP
-    "fall" // ANIM_FALL
-  };
+int Actor::sleepingCount = 0;
 
 Actor::Actor() :
   animState(),
   physics(this),
-  explosion(),
   controller(nullptr),
   attributes(),
   aiController(this),
@@ -28,8 +25,12 @@ Actor::Actor() :
   pauseTimer(0.f),
   attackId(-1),
   attackMask(0),
-  god(false)
-{}
+  god(false),
+  asleep(false),
+  lodTime(0.f)
+{
+  animState.setSoundSource(&getPosition());
+}
 
 Actor::~Actor()
 {
@@ -46,12 +47,55 @@ void Actor::setAIControlled()
   setController(&aiController);
 }
 
-void Actor::draw(float scrollFactor) const
+Actor::Snapshot::Snapshot() :
+  model(), mask(0), position(), offset(), control(CONTROL_NONE), attributes(),
+  currentAnim(ANIM_IDLE), actionState(ACTION_NORMAL), pauseTimer(0.f), attackId(-1), attackMask(0), god(false),
+  asleep(false), lodTime(0.f), anim(), physics(), ai() {}
+
+void Actor::save(Snapshot &s, const EntityIDs &ids) const
 {
-  if (!isAlive()) {
-    explosion.draw(scrollFactor);
-    return;
+  s.mask = getMask();
+  s.position = getPosition();
+  s.offset = getOffset();
+  s.control = controller == nullptr ? CONTROL_NONE : controller == &aiController ? CONTROL_AI : CONTROL_PLAYER;
+  s.attributes = attributes;
+  s.currentAnim = currentAnim;
+  s.actionState = actionState;
+  s.pauseTimer = pauseTimer;
+  s.attackId = attackId;
+  s.attackMask = attackMask;
+  s.god = god;
+  s.asleep = asleep;
+  s.lodTime = lodTime;
+  animState.save(s.anim);
+  physics.save(s.physics);
+  aiController.save(s.ai, ids);
+}
+
+void Actor::restore(const Snapshot &s, const EntityIDs &ids)
+{
+  setOffset(s.offset);
+  attributes = s.attributes;
+  currentAnim = static_cast<ActorAnim>(s.currentAnim);
+  actionState = static_cast<ActionState>(s.actionState);
+  pauseTimer = s.pauseTimer;
+  attackId = s.attackId;
+  attackMask = s.attackMask;
+  god = s.god;
+  lodTime = s.lodTime;
+  animState.restore(s.anim);
+  physics.restore(s.physics);
+
+  if (s.control == CONTROL_AI) {
+    setAIControlled();
+    aiController.restore(s.ai, ids);
   }
+  if (s.asleep) sleep();
+}
+
+void Actor::draw(float scrollFactor) const
+{
+  if (!isAlive() || asleep) return;
   
   auto anim = animState.getDrawData();
   anim.first->draw( getPosition()[0], getPosition()[1], anim.second, scrollFactor);
@@ -61,12 +105,34 @@ void Actor::update(float delta)
 {
   if (isAlive() && attributes.health <= 0.f) destroy();
   
+  // Our chunks fly off on their own, so there is nothing left to do once dead
   if (!isAlive()) {
-    if (!explosion.isAlive())
-      deactivate();
-    else explosion.update(delta);
+    deactivate();
     return;
   }
+
+  const Settings::Activity &activity = GameConfig::getInstance().get().activity;
+  const Viewport &view = Viewport::getInstance();
+  Vec2f fromView = getPosition() - view.getPosition();
+  float viewDist = fromView.length();
+  if (asleep) {
+    if (viewDist > activity.wakeDist) return;
+    wake();
+  }
+
+  // Enemies well off screen update a few times a second, all at once and
+  // without a sound. Coming closer catches up on whatever time is left over.
+  bool offScreen = std::fabs(fromView[0]) > view.getWidth()*.5f/view.getZoomFactor() + activity.lodMargin ||
+    std::fabs(fromView[1]) > view.getHeight()*.5f/view.getZoomFactor() + activity.lodMargin;
+  bool reduced = controller == &aiController && activity.lodRate > 0.f && offScreen;
+  if (reduced) {
+    lodTime += delta;
+    if (lodTime < 1.f / activity.lodRate) return;
+    delta = lodTime;
+  }
+  else delta += std::max(lodTime, 0.f);
+  lodTime = 0.f;
+  animState.setMuted(reduced);
   
   if (controller != nullptr) controller->update(delta);
 
@@ -81,8 +147,8 @@ void Actor::update(float delta)
     // Handle ground-related animations
     else if (physics.getVisibleState() == ActorPhysics::STATE_GROUND) {
       if (currentAnim == ANIM_FALL) {
-	const SoundSet &landSoundSet = animState.getAnimSet()->getAnimation(ANIM_MAP[ANIM_RUN]).getSoundSet();
-	if (!landSoundSet.empty()) landSoundSet.playRandomSound();
+	const SoundSet *landSound = static_cast<const ActorModel*>(getModel())->getLandSound();
+	if (landSound != nullptr && !landSound->empty() && !reduced) landSound->playRandomSound(getPosition());
       }
 
       if (physics.getVelocity()[1] >= 0.f) {
@@ -107,12 +173,40 @@ void Actor::update(float delta)
     }
   }
 
-  if (pauseTimer <= 0.f)
-    animState.update(delta);
-  else
-    pauseTimer -= delta;
+  // The AnimationSystem moves the animation along after every entity has updated
+  animState.setPaused(pauseTimer > 0.f);
+  if (pauseTimer > 0.f) pauseTimer -= delta;
   
-  physics.update(delta);
+  if (reduced) physics.updateReduced(delta);
+  else physics.update(delta);
+
+  if (canSleep()) sleep();
+}
+
+void Actor::sleep()
+{
+  if (asleep) return;
+  asleep = true;
+  sleepingCount++;
+  animState.setPaused(true);
+}
+
+void Actor::wake()
+{
+  if (!asleep) return;
+  asleep = false;
+  sleepingCount--;
+  animState.setPaused(pauseTimer > 0.f);
+}
+
+bool Actor::canSleep() const
+{
+  if (controller != &aiController || actionState != ACTION_NORMAL || pauseTimer > 0.f) return false;
+  if (physics.getVisibleState() != ActorPhysics::STATE_GROUND || physics.getVelocity()[0] != 0.f || physics.getVelocity()[1] != 0.f)
+    return false;
+
+  const Settings::Activity &activity = GameConfig::getInstance().get().activity;
+  return (getPosition() - Viewport::getInstance().getPosition()).length() > std::max(activity.sleepDist, activity.wakeDist);
 }
 
 void Actor::attack(int id, int mask)
@@ -126,7 +220,7 @@ void Actor::attack(int id, int mask)
   attackId = id;
   attackMask = mask;
   changeAnimState(ANIM_SPECIAL);
-  animState.playAnimation( model.getAttack(id).animation ); // TO-DO: change specific to attack
+  animState.playAnimation( model.getAttack(id).animationID ); // TO-DO: change specific to attack
   physics.setMovement(0.f);
 }
 
@@ -148,6 +242,11 @@ void Actor::moveX(float factor)
     animState.setDirection( Animation::DIR_LEFT );
 }
 
+int Actor::getAnimID(ActorAnim anim) const
+{
+  return static_cast<const ActorModel*>(getModel())->getAnimID(anim);
+}
+
 float Actor::getHealthPercent() const
 {
   return std::max(attributes.health/static_cast<const ActorModel*>(getModel())->getAttributes().health,0.f);
@@ -158,7 +257,7 @@ void Actor::activateImpl()
   const ActorModel &model = *static_cast<const ActorModel*>(getModel());
 
   // Start off by playing the idle animation
-  animState.activate(&model.getAnimSet(), ANIM_MAP[ANIM_IDLE]);
+  animState.activate(&model.getAnimSet(), model.getAnimID(ANIM_IDLE));
 
   // Set physics properties and reset velocity, etc...
   physics.activate(&model.getPhysics());
@@ -171,6 +270,12 @@ void Actor::activateImpl()
   actionState = ACTION_NORMAL;
 
   god = false;
+  asleep = false;
+
+  // Spread out when far away enemies take their turns, by starting some of
+  // them a little behind
+  const Settings::Activity &activity = GameConfig::getInstance().get().activity;
+  lodTime = activity.lodRate > 0.f ? -Random::getInstance().real() / activity.lodRate : 0.f;
 
   maskCounts[getMask()]++;
 }
@@ -184,8 +289,25 @@ BoundingBox Actor::getBoundingBox() const
 		      getPosition()[1] );
 }
 
+bool Actor::shapeCircleIntersection(const Vec2f &cpos, float crad) const
+{
+  // Left facing frames are already flipped on the sheet, so their shapes are too
+  auto draw = animState.getDrawData();
+  const Image &image = *draw.first;
+  unsigned count = image.getHullSize(draw.second);
+  if (count == 0) return true;
+
+  Vec2f corner = getPosition() + Vec2f(image.getFrameCenterX(draw.second), image.getFrameCenterY(draw.second));
+  return PhysicsManager::convexCircleIntersection( image.getHullVertices(draw.second), image.getHullNormals(draw.second),
+						   count, corner, cpos, crad );
+}
+
 void Actor::registerEntityCollision( Entity* other )
 {
+  // Bumped by something that's up and about. Sleepers leaning on each other stay asleep.
+  Actor *actor = dynamic_cast<Actor*>(other);
+  if (actor != nullptr && !actor->isAsleep()) wake();
+
   //if (getMask()&PhysicsManager::MASK_PLAYER && other->getMask()&PhysicsManager::MASK_ENEMY)
   //  destroy();
   if (dynamic_cast<Actor*>(other)) {
@@ -203,6 +325,7 @@ void Actor::registerEntityCollision( Entity* other )
 
 void Actor::registerHitBoxCollision( const HitBox *hb )
 {
+  wake();
   if (!god)
     attributes.health -= hb->getModel()->getDamage();
 
@@ -216,20 +339,24 @@ void Actor::registerHitBoxCollision( const HitBox *hb )
 
 void Actor::deactivateImpl()
 {
+  wake();
   setController(nullptr);
+  animState.deactivate();
+  NavGraph::getInstance().forgetTarget(this);
   maskCounts[getMask()]--;
 }
 
 void Actor::destroyImpl()
 {
-  explosion.spawn(animState.getDrawData().first, animState.getDrawData().second, getPosition(), physics.getVelocity()*.5f);
-  static_cast<const ActorModel*>(getModel())->playDeathSound();
+  ChunkManager::getInstance().spawn(animState.getDrawData().first, animState.getDrawData().second, getPosition(), physics.getVelocity()*.5f);
+  static_cast<const ActorModel*>(getModel())->playDeathSound(getPosition());
 }
 
 void Actor::changeAnimState( ActorAnim newState )
 {
   if (currentAnim == newState || (currentAnim = newState) == ANIM_SPECIAL) return;
-  animState.playAnimation( ANIM_MAP[currentAnim] );
+  int id = getAnimID(currentAnim);
+  if (id >= 0) animState.playAnimation(id);
 }
 
 void Actor::setController( ActorController *newController )
@@ -5,13 +5,15 @@
 #include "actormodel.h"
 #include "actorphysics.h"
 #include "aicontroller.h"
-#include "chunkexplosion.h"
+
+#include <map>
 
 #include "../entity.h"
 #include "../entitymodel.h"
 
 class ActorController;
 class PlayerController;
+class EntityIDs;
 
 class Actor : public Entity
 {
@@ -25,6 +27,7 @@ class Actor : public Entity
   virtual BoundingBox getBoundingBox() const override;
   void registerEntityCollision(Entity*) override;
   void registerHitBoxCollision(const HitBox*) override;
+  bool shapeCircleIntersection(const Vec2f &cpos, float crad) const override;
 
   AnimationState &getAnimationState() { return animState; }
   ActorPhysics &getPhysics() { return physics; }
@@ -42,6 +45,13 @@ class Actor : public Entity
   void setGod(bool g) { god = g; }
   bool isAGod() const { return god; }
 
+  // AI actors standing still on the ground far from the view go to sleep:
+  // no thinking, physics, animation or drawing until the view comes back
+  // near or something hits them
+  bool isAsleep() const { return asleep; }
+  void wake();
+  static int getSleepingCount() { return sleepingCount; }
+
   Actor(const Actor&) = delete;
   Actor &operator=(const Actor&) = delete;
 
@@ -58,14 +68,50 @@ class Actor : public Entity
 
   void changeAnimState( ActorAnim );
 
+  // The current model's animation ID for the state, -1 if it doesn't have one
+  int getAnimID( ActorAnim ) const;
+
   static int getMaskCounts(int m) { return maskCounts[m]; }
+
+  enum Control
+  {
+    CONTROL_NONE,
+    CONTROL_PLAYER,
+    CONTROL_AI
+  };
+
+  // Everything that changes while the actor is alive. The model's name is
+  // filled in by the GameManager, which knows it.
+  struct Snapshot
+  {
+    Snapshot();
+    std::string model;
+    int mask;
+    Vec2f position, offset;
+    int control;
+    ActorAttributes attributes;
+    int currentAnim, actionState;
+    float pauseTimer;
+    int attackId, attackMask;
+    bool god, asleep;
+    float lodTime;
+    AnimationState::Snapshot anim;
+    ActorPhysics::Snapshot physics;
+    AIController::Snapshot ai;
+  };
+
+  void save(Snapshot&, const EntityIDs&) const;
+
+  // After being spawned from the snapshot's model. Player control is left to
+  // whoever owns the PlayerController.
+  void restore(const Snapshot&, const EntityIDs&);
   
  private:
   static std::map<int,int> maskCounts;
+  static int sleepingCount;
   
   AnimationState animState;
   ActorPhysics physics;
-  ChunkExplosion explosion;
   ActorController *controller;
 
   // Current attribute level
@@ -98,6 +144,15 @@ class Actor : public Entity
 
   // Very temporary thing
   bool god;
+
+  bool asleep;
+  void sleep();
+
+  // Far from the view and with nothing going on
+  bool canSleep() const;
+
+  // Time saved up while far from the view, for the next reduced update
+  float lodTime;
 };
 
 #endif
@@ -1,6 +1,15 @@
 #include "actormodel.h"
 #include "aibehavior.h"
 
+// Animation names of each Actor::ActorAnim, in the same order
+const std::vector<std::string> ACTOR_ANIM_NAMES =
+  { "idle", // ANIM_IDLE
+    "walk", // ANIM_WALK
+    "run",  // ANIM_RUN
+    "jump", // ANIM_JUMP
+    "fall"  // ANIM_FALL
+  };
+
 ActorModel::ActorModel(const XMLTag& tag) :
   EntityModel(),
   animSet(tag["animset"]),
@@ -8,8 +17,20 @@ ActorModel::ActorModel(const XMLTag& tag) :
   aiBehavior(nullptr),
   attributes(tag["attributes"]),
   attackSet(),
-  deathSound()
+  deathSound(),
+  animIDs(),
+  landSound(nullptr)
 {
+  for (const std::string &name : ACTOR_ANIM_NAMES)
+    animIDs.push_back(animSet.getAnimationID(name));
+
+  // Actors start out idle (and go back to it), the rest are optional
+  if (animIDs[0] < 0)
+    throw std::string("Actor has no 'idle' animation");
+
+  int run = animSet.getAnimationID("run");
+  if (run >= 0) landSound = &animSet.getAnimation(run).getSoundSet();
+
   if (tag.hasChild("behavior")) {
     aiBehavior = new AIBehavior(tag["behavior"]);
   }
@@ -17,7 +38,9 @@ ActorModel::ActorModel(const XMLTag& tag) :
   if (tag.hasChild("attackSet")) {
     const XMLTag &as = tag["attackSet"];
     std::for_each(as.getChildren().begin(), as.getChildren().end(), [this](const XMLTag* t) {
-	attackSet.emplace_back(*t);} );
+	attackSet.emplace_back(*t);
+	if ((attackSet.back().animationID = animSet.getAnimationID(attackSet.back().animation)) < 0)
+	  throw std::string("Attack animation '" + attackSet.back().animation + "' does not exist"); } );
   }
 
   if (tag["death"].hasChild("soundSet"))
@@ -32,6 +55,7 @@ ActorModel::~ActorModel()
 ActorModel::Attack::Attack(const XMLTag& tag) :
   hitBox(tag["hitBox"]),
   animation(tag["animation"].toStr()),
+  animationID(-1),
   hitDelay(tag["hitDelay"].toFloat()) {}
 
 ActorAttributes::ActorAttributes(const XMLTag &tag) : health(tag["health"].toFloat()), super(tag["super"].toBool()) {}
@@ -26,6 +26,12 @@ class ActorModel : public EntityModel
   virtual ~ActorModel();
 
   const AnimationSet &getAnimSet() const { return animSet; }
+
+  // Animation ID for each Actor::ActorAnim, -1 if the model doesn't have it
+  int getAnimID(int actorAnim) const { return animIDs[actorAnim]; }
+
+  // Played when landing on the ground (the run animation's sounds), or nullptr
+  const SoundSet *getLandSound() const { return landSound; }
   const ActorPhysicsModel &getPhysics() const { return physics; }
   const AIBehavior *getBehavior() const { return aiBehavior; }
   const ActorAttributes &getAttributes() const { return attributes; }
@@ -37,16 +43,23 @@ class ActorModel : public EntityModel
     // TO-DO: add support for many with a priority list (or have that list within hitbox)
     HitBoxModel hitBox;
     std::string animation;
+    int animationID; // Filled in by the model once its animations are loaded
     float hitDelay;
 
-  Attack(Attack&& rhs) : hitBox(std::move(rhs.hitBox)), animation(std::move(rhs.animation)), hitDelay(rhs.hitDelay) {}
+  Attack(Attack&& rhs) : hitBox(std::move(rhs.hitBox)), animation(std::move(rhs.animation)), animationID(rhs.animationID), hitDelay(rhs.hitDelay) {}
   };
 
   // After I add animations, this will be a bit more than just a "hit box"
   // I also need an option for firing projectiles, etc...
   const Attack &getAttack(int id) const { return attackSet.at(id); }
 
-  void playDeathSound() const { if (!deathSound.empty()) deathSound.playRandomSound(); }
+  // Which attack the hit box model belongs to, -1 if none of ours
+  int getAttackID(const HitBoxModel *hb) const {
+    for (unsigned i = 0; i < attackSet.size(); i++) if (&attackSet[i].hitBox == hb) return i;
+    return -1; }
+  int getAttackCount() const { return attackSet.size(); }
+
+  void playDeathSound(const Vec2f &pos) const { if (!deathSound.empty()) deathSound.playRandomSound(pos); }
 
   ActorModel() = delete;
   ActorModel(const ActorModel&) = delete;
@@ -62,6 +75,9 @@ class ActorModel : public EntityModel
   std::vector<Attack> attackSet;
 
   SoundSet deathSound;
+
+  std::vector<int> animIDs;
+  const SoundSet *landSound;
 };
 
 #endif
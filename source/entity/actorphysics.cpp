@@ -2,6 +2,7 @@
 
 #include "../physicsmanager.h"
 #include "../entity.h"
+#include "../stats.h"
 
 #include <limits>
 #include <cmath>
@@ -12,6 +13,10 @@ const Vec2f RIGHT_VECTOR = Vec2f(1,0);
 const float MAX_SLOPE = 0.7;
 const float FALL_SPEED = 8000;
 
+// How many surfaces the air state can run into (and slide along) in one
+// update before it just stops at the last one
+const int MAX_CONTACTS = 4;
+
 float angle = 0.f;
 
 ActorPhysics::ActorPhysics(Entity *o) :
@@ -43,6 +48,133 @@ void ActorPhysics::activate(const ActorPhysicsModel *newModel)
   owner->setOffsetY(0);
 }
 
+ActorPhysics::Snapshot::Snapshot() :
+  state(STATE_AIR), visibleState(STATE_AIR), ledgeState(LEDGE_NONE), wallState(WALL_NONE),
+  velocity(), disabledTime(0.f), spriteOffsetVelocity(0.f), spriteFakeState(SPRITE_NONE), movement(0.f),
+  groundC(), groundD(), groundRight(), groundLedge(false), groundSegment(-1) {}
+
+void ActorPhysics::save(Snapshot &s) const
+{
+  s.state = state;
+  s.visibleState = visibleState;
+  s.ledgeState = ledgeState;
+  s.wallState = wallState;
+  s.velocity = velocity;
+  s.disabledTime = disabledTime;
+  s.spriteOffsetVelocity = spriteOffsetVelocity;
+  s.spriteFakeState = spriteFakeState;
+  s.movement = movement;
+  s.groundC = ground.c;
+  s.groundD = ground.d;
+  s.groundRight = ground.right;
+  s.groundLedge = ground.ledge;
+  s.groundSegment = ground.segment;
+}
+
+void ActorPhysics::restore(const Snapshot &s)
+{
+  state = static_cast<State>(s.state);
+  visibleState = static_cast<State>(s.visibleState);
+  ledgeState = static_cast<LedgeState>(s.ledgeState);
+  wallState = static_cast<WallState>(s.wallState);
+  velocity = s.velocity;
+  disabledTime = s.disabledTime;
+  spriteOffsetVelocity = s.spriteOffsetVelocity;
+  spriteFakeState = static_cast<SpriteFakeState>(s.spriteFakeState);
+  movement = s.movement;
+  ground.c = s.groundC;
+  ground.d = s.groundD;
+  ground.right = s.groundRight;
+  ground.ledge = s.groundLedge;
+  ground.segment = s.groundSegment;
+}
+
+void ActorPhysics::moveHoriz(float delta, float spd, float acc, float dec)
+{
+  const float EPSILON = PhysicsManager::EPSILON;
+  if (disabledTime > 0.f) return;
+  if (movement > EPSILON)
+    velocity[0] = std::min( spd * movement, velocity[0] + acc * delta );
+  else if (movement < -EPSILON)
+    velocity[0] = std::max( spd * movement, velocity[0] - acc * delta );
+  else if (fabs(velocity[0]) >= EPSILON) {
+    float dir = velocity[0] / fabs(velocity[0]);
+    velocity[0] *= dir;
+    velocity[0] = std::max(velocity[0] - dec * delta, 0.f);
+    velocity[0] *= dir;
+  }
+  else velocity[0] = 0.f;
+}
+
+void ActorPhysics::updateReduced(float delta)
+{
+  if (!followGround(delta)) update(delta);
+}
+
+bool ActorPhysics::followGround(float delta)
+{
+  const float EPSILON = PhysicsManager::EPSILON;
+  if (state != STATE_GROUND || ground.ledge || spriteFakeState != SPRITE_NONE || disabledTime > 0.f || velocity[1] < 0.f)
+    return false;
+
+  PhysicsManager &physics = PhysicsManager::getInstance();
+  if (physics.getSegment(ground.segment) == nullptr) return false;
+
+  Vec2f oldVelocity = velocity;
+  moveHoriz( delta, model->groundSpeed, model->groundAcc, model->groundDec );
+
+  // Walk along the ground, and on to the next segment at either end as long
+  // as there's a walkable one linked
+  const Vec2f &pos = owner->getPosition();
+  Vec2f p = pos, c = ground.c, d = ground.d;
+  int id = ground.segment, side = velocity[0] < 0.f ? -1 : 1;
+  float remaining = std::fabs(velocity[0]) * delta;
+  for (int steps = 0;; steps++) {
+    Vec2f right = (d - c).normalize();
+    const Vec2f &edge = side == 1 ? d : c;
+    float toEdge = std::max(std::fabs(edge[0] - p[0]) / right[0], 0.f);
+    if (remaining <= toEdge) {
+      p[0] += right[0] * remaining * side;
+      break;
+    }
+
+    const Segment *s = physics.getSegment(id);
+    int link = side == 1 ? s->getNext() : s->getPrev();
+    const Segment *next = physics.getSegment(link);
+    Vec2f normal = next != nullptr ? (*next)[0] - (*next)[1] : Vec2f(0, 0);
+    normal = Vec2f(-normal[1], normal[0]).normalize();
+    if (next == nullptr || normal[1] >= -MAX_SLOPE || steps >= 8) {
+      velocity = oldVelocity;
+      return false;
+    }
+
+    remaining -= toEdge;
+    p[0] = edge[0];
+    id = link;
+    c = (*next)[0];
+    d = (*next)[1];
+  }
+  p[1] = c[1] + ((p[0] - c[0]) / (d[0] - c[0])) * (d[1] - c[1]) - EPSILON;
+
+  // Anything standing on the ground in the way needs the full update
+  Vec2f waist = UP_VECTOR * model->dimensions[1] * .5f;
+  if (p[0] != pos[0] && !physics.lineOfSight(pos + waist, p + waist)) {
+    velocity = oldVelocity;
+    return false;
+  }
+
+  ground.c = c;
+  ground.d = d;
+  ground.right = (d - c).normalize();
+  ground.segment = id;
+  velocity[1] = 0.f;
+  visibleState = STATE_GROUND;
+  ledgeState = LEDGE_NONE;
+  wallState = WALL_NONE;
+  owner->setPosition(p);
+  return true;
+}
+
 void ActorPhysics::update(float delta)
 {
   const float EPSILON = PhysicsManager::EPSILON;
@@ -50,6 +182,10 @@ void ActorPhysics::update(float delta)
   const Vec2f &pos = owner->getPosition();
   const ActorPhysicsModel &m = *model;
 
+  // Edges of the ground followed by link, and ones that needed a ray
+  static const int statLinks = Stats::getInstance().add("physics.groundLinks", Stats::COUNTER),
+    statCasts = Stats::getInstance().add("physics.groundCasts", Stats::COUNTER);
+
   wallState = WALL_NONE;
   
   // Directional influence vector. Influenced by velocity, collisions, and angle of the ground.
@@ -106,6 +242,7 @@ void ActorPhysics::update(float delta)
 
     ground.right = Vec2f(1,0);
     ground.ledge = true;
+    ground.segment = -1;
 
     c = d;
     d = ground.d + ground.right * (m.halfWidth + EPSILON) * e;
@@ -113,21 +250,6 @@ void ActorPhysics::update(float delta)
     owner->setY( c[1] - EPSILON );
   };
 
-  auto moveHoriz = [&delta, EPSILON, this](float spd, float acc, float dec) {
-    if (disabledTime > 0.f) return;
-    if (movement > EPSILON)
-      velocity[0] = std::min( spd * movement, velocity[0] + acc * delta );
-    else if (movement < -EPSILON)
-      velocity[0] = std::max( spd * movement, velocity[0] - acc * delta );
-    else if (fabs(velocity[0]) >= EPSILON) {
-      float dir = velocity[0] / fabs(velocity[0]);
-      velocity[0] *= dir;
-      velocity[0] = std::max(velocity[0] - dec * delta, 0.f);
-      velocity[0] *= dir;
-    }
-    else velocity[0] = 0.f;
-  };
-
   auto edgeAdjustedCorner = [&m, this](const Vec2f &normal) {
     return Vec2f( m.halfWidth,
 		     (m.halfWidth / normal[0]) * normal[1] );
@@ -173,7 +295,7 @@ void ActorPhysics::update(float delta)
     }
 
     // Move horizontally in the air in the desired direction from input
-    moveHoriz( m.airSpeed, m.airAcc, m.airDec );
+    moveHoriz( delta, m.airSpeed, m.airAcc, m.airDec );
 
     // Add gravity
     velocity[1] += PhysicsManager::GRAVITY * m.fallFactor * delta;
@@ -201,6 +323,7 @@ void ActorPhysics::update(float delta)
 	ground.c = result.c;
 	ground.d = result.d;
 	ground.right = (ground.d - ground.c).normalize();
+	ground.segment = result.segment;
 
 	// If we are touching ground that can be stood on...
 	if (velocity[1] > 0 && result.normal[1] < -MAX_SLOPE) {
@@ -219,6 +342,7 @@ void ActorPhysics::update(float delta)
 	    ground.c = slope.c;
 	    ground.d = slope.d;
 	    ground.right = (ground.d - ground.c).normalize();
+	    ground.segment = slope.segment;
 
 	    // Illusion of falling softly to the ground instead of snapping
 	    spriteFakeState = SPRITE_FALL;
@@ -321,6 +445,10 @@ void ActorPhysics::update(float delta)
 	  dir = PhysicsManager::rayStop( dir, -dir.normalize(), result.t );
 	}
 	// Adjust direction vector to slide against surface.
+	// Out of contacts. Stop here rather than slide somewhere unchecked.
+	else if (maxcol >= MAX_CONTACTS) {
+	  dir = PhysicsManager::rayStop( dir, -dir.normalize(), result.t );
+	}
 	else {
 	  dir = PhysicsManager::raySlide( dir, result.normal, result.t );
 	  
@@ -333,10 +461,8 @@ void ActorPhysics::update(float delta)
 	  //  velocity[0] = result.normal[0];//result.normal[0] * PhysicsManager::GRAVITY * m.fallFactor * delta;
 	    //}
 
-	  // Only do another collision chech if we slide. Also don't do too many
-	  // collision checks since they are expensive.
-	  // TEMP: For now, let me know when this happens.
-	  if (++maxcol > 4) throw std::string("TOO MANY COLLISIONS");
+	  // Only do another collision check if we slide
+	  maxcol++;
 	}
       }
     }
@@ -368,7 +494,7 @@ void ActorPhysics::update(float delta)
     visibleState = spriteFakeState == SPRITE_NONE ? STATE_GROUND : STATE_AIR;
 
     // Attempt to move along the ground in the desired direction
-    moveHoriz( m.groundSpeed, m.groundAcc, m.groundDec );
+    moveHoriz( delta, m.groundSpeed, m.groundAcc, m.groundDec );
 
     // Make sure to stop downward velocity
     velocity[1] = std::min(velocity[1], 0.f);
@@ -459,11 +585,31 @@ void ActorPhysics::update(float delta)
 	// collision results.
 	
 
-	// Detect what the next ground might be if we continue walking off the edge
-	PhysicsManager::RayResult next_ground =
-	  physics.rayCast( PhysicsManager::MASK_WORLD,
-			   targetPos + UP_VECTOR * (m.halfWidth + EPSILON) + ground.right * newEdge * EPSILON,
-			   targetPos + DOWN_VECTOR * (m.halfWidth + EPSILON) + ground.right * newEdge * EPSILON );
+	// Detect what the next ground might be if we continue walking off the edge.
+	// If the ground is linked to a walkable segment carrying on from this end
+	// (see SegmentWeld) that's the one. A wall or ceiling linked on still needs
+	// the ray, since some other ground may be under the edge.
+	PhysicsManager::RayResult next_ground;
+	const Segment *current = physics.getSegment(ground.segment);
+	int link = current == nullptr ? -1 : newEdge == 1 ? current->getNext() : current->getPrev();
+	const Segment *linked = physics.getSegment(link);
+	Vec2f linkNormal = linked != nullptr ? (*linked)[0] - (*linked)[1] : Vec2f(0, 0);
+	linkNormal = Vec2f(-linkNormal[1], linkNormal[0]).normalize();
+	if (linked != nullptr && linkNormal[1] < -MAX_SLOPE) {
+	  next_ground.hit = true;
+	  next_ground.normal = linkNormal;
+	  next_ground.c = (*linked)[0];
+	  next_ground.d = (*linked)[1];
+	  next_ground.segment = link;
+	  Stats::getInstance().count(statLinks);
+	}
+	else {
+	  next_ground =
+	    physics.rayCast( PhysicsManager::MASK_WORLD,
+			     targetPos + UP_VECTOR * (m.halfWidth + EPSILON) + ground.right * newEdge * EPSILON,
+			     targetPos + DOWN_VECTOR * (m.halfWidth + EPSILON) + ground.right * newEdge * EPSILON );
+	  Stats::getInstance().count(statCasts);
+	}
       
 	// If we detect new walkable ground, do not treat this ground's edge as a ledge, but instead
 	// snap to the new ground
@@ -471,6 +617,7 @@ void ActorPhysics::update(float delta)
 	  ground.c = next_ground.c;
 	  ground.d = next_ground.d;
 	  ground.right = (ground.d - ground.c).normalize();
+	  ground.segment = next_ground.segment;
 	  ground.ledge = false;
 	  ledgeState = LEDGE_NONE;
 	}
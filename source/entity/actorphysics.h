@@ -36,6 +36,11 @@ class ActorPhysics
   void activate(const ActorPhysicsModel* m);
   void update(float delta);
 
+  // For actors far from the view, which update less often. Walking along
+  // linked ground just follows the links with one check for anything in the
+  // way, and anything else gets the full update.
+  void updateReduced(float delta);
+
   State getState() const { return state; }
   State getVisibleState() const { return visibleState; }
   LedgeState getLedgeState() const { return ledgeState; }
@@ -68,6 +73,23 @@ class ActorPhysics
   float getJumpStrength() const { return model->jumpStrength; }
   const std::vector<Vec2f> &getBoxPoints() const { return model->boxPts; }
 
+  // Everything but the model, which comes from the actor's
+  struct Snapshot
+  {
+    Snapshot();
+    int state, visibleState, ledgeState, wallState;
+    Vec2f velocity;
+    float disabledTime, spriteOffsetVelocity;
+    int spriteFakeState;
+    float movement;
+    Vec2f groundC, groundD, groundRight;
+    bool groundLedge;
+    int groundSegment;
+  };
+
+  void save(Snapshot&) const;
+  void restore(const Snapshot&);
+
   ActorPhysics() = delete;
   ActorPhysics(const ActorPhysics&) = delete;
   ActorPhysics &operator=(const ActorPhysics&) = delete;
@@ -103,14 +125,25 @@ class ActorPhysics
 
   // The information of the current ground surface (point point line) we are standing on
   struct GroundData {
-    GroundData() : c(Vec2f(0,0)), d(Vec2f(0,0)), right(Vec2f(0,0)), ledge(0) {}
+    GroundData() : c(Vec2f(0,0)), d(Vec2f(0,0)), right(Vec2f(0,0)), ledge(0), segment(-1) {}
     Vec2f c, d;
     Vec2f right;
 
     // Are we on a ledge? (the midpoint of the box is sticking past the edge of an obstacle)
     bool ledge;
+
+    // The ID of the segment c and d came from, so walking off either end can
+    // follow its links. -1 for ledges, corners and segments without links.
+    int segment;
   } ground;
 
+  // Speeds up or slows down toward the target movement
+  void moveHoriz(float delta, float spd, float acc, float dec);
+
+  // The cheap part of updateReduced. False (with nothing changed) if there's
+  // more going on than walking along linked ground.
+  bool followGround(float delta);
+
 
 };
 
@@ -4,6 +4,7 @@
 
 AIBehavior::AIBehavior(const XMLTag& tag) :
   sight(tag["sight"].toFloat()),
+  perceptionRate(tag.hasChild("perceptionHz") ? tag["perceptionHz"].toFloat() : 10.f),
   idleState(tag["state_idle"]),
   patrolState(tag["state_patrol"]),
   chaseState(tag["state_chase"]) {}
@@ -36,6 +36,7 @@ class AIBehavior
   };
 
   float              getSight() const { return sight; }
+  float              getPerceptionRate() const { return perceptionRate; }
   const IdleState   &getIdleState() const { return idleState; }
   const PatrolState &getPatrolState() const { return patrolState; }
   const ChaseState  &getChaseState() const { return chaseState; }
@@ -45,6 +46,7 @@ class AIBehavior
 
  private:
   float sight;
+  float perceptionRate; // How many times per second to look for targets
   IdleState idleState;
   PatrolState patrolState;
   ChaseState chaseState;
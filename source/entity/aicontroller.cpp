@@ -2,12 +2,19 @@
 #include "aibehavior.h"
 #include "actor.h"
 #include "actormodel.h"
+#include "perceptionscheduler.h"
 
 #include "../physicsmanager.h"
+#include "../navgraph.h"
+#include "../random.h"
+#include "../gamesnapshot.h"
 
 const float SIT_DIST = 32.f;
+const float NAV_REACH = 48.f; // How close to a takeoff point counts as there
 
-AIController::AIController(Actor *owner) : ActorController(owner), state(STATE_IDLE), stateTimer(0.f), originPos(Vec2f(0,0)), target(nullptr) {}
+AIController::AIController(Actor *owner) : ActorController(owner), state(STATE_IDLE), stateTimer(0.f), originPos(Vec2f(0,0)), target(nullptr), perceptionTimer(0.f),
+  sightTarget(nullptr), sightFrom(Vec2f(0,0)), sightTo(Vec2f(0,0)), sightAge(0.f), sightVisible(false),
+  targetNode(-1), navLink(-1), navJump(false) {}
 
 AIController::~AIController() {}
 
@@ -17,6 +24,11 @@ void AIController::initiate()
   changeState(STATE_IDLE);
   originPos = getOwner()->getPosition();
   target = nullptr;
+
+  const AIBehavior &behavior = *static_cast<const ActorModel*>(getOwner()->getModel())->getBehavior();
+  perceptionTimer = PerceptionScheduler::getInstance().randomPhase(behavior.getPerceptionRate());
+  sightTarget = nullptr;
+  targetNode = navLink = -1;
 }
 
 void AIController::update(float delta)
@@ -27,6 +39,7 @@ void AIController::update(float delta)
   ActorPhysics &physics = getOwner()->getPhysics();
 
   const Vec2f &pos = getOwner()->getPosition();
+  sightAge += delta;
   
   // Handle switching between idle and patrol states.
   if (state == STATE_IDLE) {
@@ -67,10 +80,12 @@ void AIController::update(float delta)
   //
   //  I'll probably change this because I plan to implement friendly AI later, but for now only detect MASK_PLAYER
   //
-  if (state == STATE_IDLE || state == STATE_PATROL) {
+  if ((state == STATE_IDLE || state == STATE_PATROL) &&
+      PerceptionScheduler::getInstance().shouldCheck(perceptionTimer, behavior.getPerceptionRate(), pos, delta)) {
     physicsMgr.queryEntityGridArea(pos, 2, PhysicsManager::MASK_PLAYER, [&pos, &behavior, this](Entity *e) {
 	if (e->isAlive() &&
-	    PhysicsManager::boxCircleIntersection(e->getBoundingBox(), pos, behavior.getSight())) {
+	    PhysicsManager::boxCircleIntersection(e->getBoundingBox(), pos, behavior.getSight()) &&
+	    canSee(e)) {
 	  changeState(STATE_CHASE);
 	  target = e;
 	}
@@ -86,26 +101,135 @@ void AIController::update(float delta)
       state = STATE_IDLE;
     }
     else {
+      NavGraph &nav = NavGraph::getInstance();
+      int node = nav.findNode(target->getPosition());
+      if (node >= 0) targetNode = node;
+
+      // Pick the next jump or drop to take if the target is on other ground.
+      // In the air, keep steering for the one we took.
+      if (physics.getState() == ActorPhysics::STATE_GROUND) {
+	navLink = -1;
+	node = nav.findNode(pos);
+	if (node >= 0 && targetNode >= 0) {
+	  const NavGraph::Step *step = nav.getFlowStep(target, targetNode, node, physics);
+	  if (step) {
+	    navLink = step->link;
+	    navJump = step->jump;
+	  }
+	}
+      }
+
       float attackDist = behavior.getChaseState().attackDist;
       float dist = target->getPosition()[0] - pos[0];
-      
-      if (dist > 0.f) animState.setDirection(Animation::DIR_RIGHT);
-      else animState.setDirection(Animation::DIR_LEFT);
-      
-      if (fabs(dist) > attackDist)
+
+      if (navLink < 0) {
+	if (dist > 0.f) animState.setDirection(Animation::DIR_RIGHT);
+	else animState.setDirection(Animation::DIR_LEFT);
+      }
+
+      if (navLink >= 0) {
+	const NavGraph::Link &link = nav.getLink(navLink);
+	if (physics.getState() == ActorPhysics::STATE_GROUND) {
+	  float toTakeoff = link.takeoff[0] - pos[0];
+	  if (fabs(toTakeoff) > NAV_REACH)
+	    getOwner()->moveX( toTakeoff/fabs(toTakeoff) );
+	  else {
+	    if (navJump) getOwner()->jump(1.f);
+	    getOwner()->moveX( link.landing[0] > pos[0] ? 1.f : -1.f );
+	  }
+	}
+	else {
+	  // Ease off near the landing spot so we don't overshoot it
+	  getOwner()->moveX( (link.landing[0] - pos[0]) / NAV_REACH );
+	}
+      }
+      else if (fabs(dist) > attackDist)
         getOwner()->moveX( dist/fabs(dist) );
       else {
         getOwner()->moveX(0.f);
 
 	if (stateTimer <= 0.f) {
 	  getOwner()->attack(0, PhysicsManager::MASK_PLAYER);
-	  stateTimer = behavior.getChaseState().attackIntervalS + drand48()*behavior.getChaseState().attackIntervalR;
+	  stateTimer = behavior.getChaseState().attackIntervalS + Random::getInstance().real()*behavior.getChaseState().attackIntervalR;
 	}
       }
     }
   }
 }
 
+AIController::Snapshot::Snapshot() :
+  state(STATE_IDLE), stateTimer(0.f), originPos(), target(-1), perceptionTimer(0.f),
+  sightTarget(-1), sightFrom(), sightTo(), sightAge(0.f), sightVisible(false),
+  targetNode(-1), navLink(-1), navJump(false) {}
+
+void AIController::save(Snapshot &s, const EntityIDs &ids) const
+{
+  s.state = state;
+  s.stateTimer = stateTimer;
+  s.originPos = originPos;
+  s.target = ids.find(target);
+  s.perceptionTimer = perceptionTimer;
+  s.sightTarget = ids.find(sightTarget);
+  s.sightFrom = sightFrom;
+  s.sightTo = sightTo;
+  s.sightAge = sightAge;
+  s.sightVisible = sightVisible;
+  s.targetNode = targetNode;
+  s.navLink = navLink;
+  s.navJump = navJump;
+}
+
+void AIController::restore(const Snapshot &s, const EntityIDs &ids)
+{
+  state = static_cast<State>(s.state);
+  stateTimer = s.stateTimer;
+  originPos = s.originPos;
+  target = ids.get(s.target);
+  perceptionTimer = s.perceptionTimer;
+  sightTarget = ids.get(s.sightTarget);
+  sightFrom = s.sightFrom;
+  sightTo = s.sightTo;
+  sightAge = s.sightAge;
+  sightVisible = s.sightVisible;
+  navJump = s.navJump;
+
+  // The nav graph gets built from the scene as it is now, which may not be
+  // what it was when the snapshot was taken
+  const NavGraph &nav = NavGraph::getInstance();
+  targetNode = s.targetNode >= 0 && s.targetNode < nav.getNodeCount() ? s.targetNode : -1;
+  navLink = s.navLink >= 0 && s.navLink < nav.getLinkCount() ? s.navLink : -1;
+
+  // Chasing someone who isn't around anymore
+  if (state == STATE_CHASE && target == nullptr) state = STATE_IDLE;
+}
+
+static Vec2f boxCenter(const BoundingBox &bb)
+{
+  return Vec2f((bb[0]+bb[2])*.5f, (bb[1]+bb[3])*.5f);
+}
+
+bool AIController::canSee(const Entity *e)
+{
+  PerceptionScheduler &scheduler = PerceptionScheduler::getInstance();
+  Vec2f from = boxCenter(getOwner()->getBoundingBox()), to = boxCenter(e->getBoundingBox());
+  float move = scheduler.getSightCacheMove();
+
+  if (e == sightTarget && sightAge < scheduler.getSightCacheTime() &&
+      (from - sightFrom).lengthSquared() < move*move &&
+      (to - sightTo).lengthSquared() < move*move) {
+    scheduler.countSightTest(true);
+    return sightVisible;
+  }
+
+  scheduler.countSightTest(false);
+  sightTarget = e;
+  sightFrom = from;
+  sightTo = to;
+  sightAge = 0.f;
+  sightVisible = PhysicsManager::getInstance().lineOfSight(from, to);
+  return sightVisible;
+}
+
 void AIController::changeState(State next)
 {
   const AIBehavior &behavior = *static_cast<const ActorModel*>(getOwner()->getModel())->getBehavior();
@@ -115,17 +239,17 @@ void AIController::changeState(State next)
   switch (state) {
     
   case STATE_IDLE:
-    stateTimer = behavior.getIdleState().timeStart + drand48()*behavior.getIdleState().timeRange;
+    stateTimer = behavior.getIdleState().timeStart + Random::getInstance().real()*behavior.getIdleState().timeRange;
     break;
     
   case STATE_PATROL:
-    stateTimer = behavior.getPatrolState().timeStart + drand48()*behavior.getPatrolState().timeRange;
+    stateTimer = behavior.getPatrolState().timeStart + Random::getInstance().real()*behavior.getPatrolState().timeRange;
 
     if (getOwner()->getPosition()[0] >= originPos[0] + behavior.getPatrolState().range*.75)
       animState.setDirection(Animation::DIR_LEFT);
     else if (getOwner()->getPosition()[0] <= originPos[0] - behavior.getPatrolState().range*.75)
       animState.setDirection(Animation::DIR_RIGHT);
-    else animState.setDirection(rand()%2==0?Animation::DIR_RIGHT:Animation::DIR_LEFT);
+    else animState.setDirection(Random::getInstance().range(2)==0?Animation::DIR_RIGHT:Animation::DIR_LEFT);
     
     break;
     
@@ -133,7 +257,7 @@ void AIController::changeState(State next)
     const SoundSet &soundSet = behavior.getChaseState().soundSet;
 
     if (soundSet.count() > 0) {
-      soundSet.playSound(0);
+      soundSet.playSound(0, getOwner()->getPosition());
     }
 
     stateTimer = 0.f;
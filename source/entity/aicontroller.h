@@ -6,6 +6,7 @@
 
 class AIBehavior;
 class Entity;
+class EntityIDs;
 
 class AIController : public ActorController
 {
@@ -23,6 +24,26 @@ class AIController : public ActorController
     STATE_CHASE
   };
 
+  // Entities are kept as their index in the snapshot (see EntityIDs)
+  struct Snapshot
+  {
+    Snapshot();
+    int state;
+    float stateTimer;
+    Vec2f originPos;
+    int target;
+    float perceptionTimer;
+    int sightTarget;
+    Vec2f sightFrom, sightTo;
+    float sightAge;
+    bool sightVisible;
+    int targetNode, navLink;
+    bool navJump;
+  };
+
+  void save(Snapshot&, const EntityIDs&) const;
+  void restore(const Snapshot&, const EntityIDs&);
+
   AIController(const AIController&) = delete;
   AIController &operator=(const AIController&) = delete;
 
@@ -31,8 +52,24 @@ class AIController : public ActorController
   float stateTimer;
   Vec2f originPos;
   Entity *target;
+
+  // Counts down to the next time we look for targets (see PerceptionScheduler)
+  float perceptionTimer;
+
+  // Last line of sight test, reused while it's recent and nobody moved much
+  const Entity *sightTarget;
+  Vec2f sightFrom, sightTo;
+  float sightAge;
+  bool sightVisible;
+
+  // Pathfinding while chasing. The target's node is remembered while it's in
+  // the air, and the link we're heading for is kept while we are.
+  int targetNode;
+  int navLink;
+  bool navJump;
   
   void changeState(State);
+  bool canSee(const Entity*);
 };
 
 #endif
@@ -57,9 +57,14 @@ Animation::Animation(const XMLTag &tag, const Image* img) :
       start = end+1;
     } while (end < fstr.length());
   } );
+
+  // Every direction gets played, and there's no frame to show for an empty one
+  for (unsigned i = 0; i < NUM_DIRECTIONS; i++)
+    if (frames[i].empty())
+      throw std::string("Animation '" + tag["name"].toStr() + "' has no frames for one of its directions");
 }
 
 unsigned Animation::getImageFrame(Direction dir, unsigned animFrame) const
 {
-  return frames.at(dir).at(animFrame);
+  return frames[dir][animFrame];
 }
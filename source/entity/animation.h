@@ -2,7 +2,6 @@
 #define ANIMATION_H
 
 #include <vector>
-#include <map>
 
 #include "../soundset.h"
 
@@ -19,11 +18,12 @@ class Animation
     DIR_RIGHT,
     DIR_LEFT
   };
+  static const int NUM_DIRECTIONS = 2;
 
   unsigned getImageFrame(Direction, unsigned animFrame) const;
   const Image *getImage() const { return image; }
 
-  unsigned getNumFrames(Animation::Direction dir) const { return frames.at(dir).size(); }
+  unsigned getNumFrames(Animation::Direction dir) const { return frames[dir].size(); }
   float getSpeed() const { return speed; }
   bool loops() const { return loop; }
 
@@ -35,7 +35,7 @@ class Animation
   
  private:
   const Image *image;
-  std::map<unsigned, std::vector<unsigned>> frames;
+  std::vector<unsigned> frames[NUM_DIRECTIONS]; // Image frames, by direction
   float speed;
   bool loop;
   SoundSet soundSet;
@@ -10,7 +10,8 @@
 #include <iostream>
 
 AnimationSet::AnimationSet(const XMLTag &tag) :
-  animations()
+  animations(),
+  ids()
 {
   std::unordered_map<unsigned, Image*> images;
   
@@ -22,14 +23,14 @@ AnimationSet::AnimationSet(const XMLTag &tag) :
     else if (t.getName() == "anim") {
       //std::cout << "Found anim '" << t["name"].toStr() << "'" << std::endl;
       int imgID = t.hasChild("image") ? t["image"].toInt() : 0;
-      animations.emplace( std::piecewise_construct,
-			  std::forward_as_tuple(t["name"].toStr()),
-			  std::forward_as_tuple(t, images.at(imgID)) );
+      ids[t["name"].toStr()] = animations.size();
+      animations.emplace_back(t, images.at(imgID));
     }
   }
 }
 
-const Animation &AnimationSet::getAnimation(const std::string &anim) const
+int AnimationSet::getAnimationID(const std::string &anim) const
 {
-  return animations.at(anim);
+  auto it = ids.find(anim);
+  return it != ids.end() ? it->second : -1;
 }
@@ -5,20 +5,26 @@
 #include "../xmltag.h"
 
 #include <unordered_map>
+#include <deque>
 
 class AnimationSet
 {
  public:
   AnimationSet(const XMLTag&);
 
-  const Animation &getAnimation(const std::string&) const;
+  // Animations are numbered in the order they're defined. Look the number up
+  // once when loading, and use it from then on.
+  int getAnimationID(const std::string&) const; // -1 if there is no such animation
+  const Animation &getAnimation(int id) const { return animations[id]; }
+  int getAnimationCount() const { return animations.size(); }
   
   AnimationSet() = delete;
   AnimationSet(const AnimationSet&) = delete;
   AnimationSet &operator=(const AnimationSet&) = delete;
   
  private:
-  std::unordered_map<std::string, Animation> animations;
+  std::deque<Animation> animations;
+  std::unordered_map<std::string, int> ids;
 };
 
 #endif
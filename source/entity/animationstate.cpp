@@ -1,77 +1,103 @@
 #include "animationstate.h"
 #include "animationset.h"
 
-#include "../soundmanager.h"
-
 AnimationState::AnimationState() :
   animSet(nullptr),
-  currentAnim(std::make_pair("BLANK", nullptr)),
-  currentSoundInterval(-1.f),
-  currentTime(0.f),
+  slot(-1),
+  currentID(-1),
+  currentAnim(nullptr),
   playSpeed(1.f),
-  lastSound(-1),
-  currentDirection(Animation::DIR_RIGHT) {}
+  currentDirection(Animation::DIR_RIGHT),
+  soundSource(nullptr) {}
 
-void AnimationState::activate(const AnimationSet* set, const std::string &startAnim)
+void AnimationState::activate(const AnimationSet* set, int startAnim)
 {
   animSet = set;
+  if (slot < 0) slot = AnimationSystem::getInstance().add(this);
+  AnimationSystem::getInstance().setPaused(slot, false);
   playAnimation(startAnim);
 }
 
-void AnimationState::playAnimation(const std::string &name)
+void AnimationState::deactivate()
 {
-  const Animation &anim = animSet->getAnimation(name);
-  currentAnim = std::make_pair(name, &anim);
-  currentTime = 0.f;
-  currentSoundInterval = 0.f;
-  lastSound = -1;
+  if (slot < 0) return;
+  AnimationSystem::getInstance().remove(slot);
+  slot = -1;
+}
 
-  const SoundSet &soundSet = currentAnim.second->getSoundSet();
-  if (!soundSet.empty() && soundSet.getSoundInterval() < 0.f) {
-    soundSet.playSound(soundSet.randomSoundID());
-  }
+void AnimationState::playAnimation(int id)
+{
+  currentID = id;
+  currentAnim = &animSet->getAnimation(id);
+  if (slot >= 0) AnimationSystem::getInstance().start(slot, currentAnim, currentDirection);
+  updateRate();
 }
 
 void AnimationState::setDirection(Animation::Direction dir)
 {
   currentDirection = dir;
-  clampTime();
+  if (slot >= 0) AnimationSystem::getInstance().setDirection(slot, dir);
 }
 
-std::pair<const Image*, unsigned> AnimationState::getDrawData() const
+void AnimationState::updateRate()
 {
-  return std::make_pair( currentAnim.second->getImage(),
-			 currentAnim.second->getImageFrame( currentDirection,
-							    std::min(static_cast<unsigned int>(currentTime),
-								     currentAnim.second->getNumFrames(currentDirection)-1) ) );
+  if (slot >= 0)
+    AnimationSystem::getInstance().setRate(slot, currentAnim->getSpeed() * playSpeed);
 }
 
-void AnimationState::update(float delta)
+AnimationState::Snapshot::Snapshot() :
+  anim(0), direction(Animation::DIR_RIGHT), playSpeed(1.f), time(0.f), soundTimer(0.f),
+  frame(0), lastSound(-1), paused(false), slot(-1) {}
+
+void AnimationState::save(Snapshot &s) const
 {
-  currentTime += delta * currentAnim.second->getSpeed() * playSpeed;
-  clampTime();
+  const AnimationSystem &system = AnimationSystem::getInstance();
+  s.anim = currentID;
+  s.direction = currentDirection;
+  s.playSpeed = playSpeed;
+  s.time = system.time[slot];
+  s.soundTimer = system.soundTimer[slot];
+  s.frame = system.frame[slot];
+  s.lastSound = system.lastSound[slot];
+  s.paused = system.running[slot] == 0.f;
+  s.slot = slot;
+}
 
-  const SoundSet &soundSet = currentAnim.second->getSoundSet();
+void AnimationState::restore(const Snapshot &s)
+{
+  AnimationSystem &system = AnimationSystem::getInstance();
+  currentID = s.anim;
+  currentAnim = &animSet->getAnimation(currentID);
+  currentDirection = static_cast<Animation::Direction>(s.direction);
+  playSpeed = s.playSpeed;
 
-  if (soundSet.getSoundInterval() > 0.f) {
-    if (currentSoundInterval < 0.f) {
-      int nextSound;
-      while ((nextSound = soundSet.randomSoundID()) == lastSound) {}
-      soundSet.playSound(lastSound = nextSound);
-      currentSoundInterval = soundSet.getSoundInterval();
-    } else currentSoundInterval -= delta;
-  }
+  // Start it like normal, but without the sound it makes when it starts
+  system.start(slot, currentAnim, currentDirection);
+  system.dropEvents(slot);
+  system.time[slot] = s.time;
+  system.soundTimer[slot] = s.soundTimer;
+  system.frame[slot] = s.frame;
+  system.imageFrame[slot] = currentAnim->getImageFrame(currentDirection, s.frame);
+  system.lastSound[slot] = s.lastSound;
+  system.setPaused(slot, s.paused);
+  updateRate();
 }
 
-void AnimationState::clampTime()
+void AnimationState::moveToSlot(int s)
+{
+  AnimationSystem &system = AnimationSystem::getInstance();
+  if (slot >= 0 && s >= 0 && s < system.count && s != slot) system.swap(slot, s);
+}
+
+std::pair<const Image*, unsigned> AnimationState::getDrawData() const
 {
-  const Animation &anim = *currentAnim.second;
-  unsigned numFrames = anim.getNumFrames(currentDirection);
-  if (currentTime > numFrames)
-    currentTime = anim.loops() ? currentTime - numFrames*(static_cast<unsigned>(currentTime+.5f) / numFrames) : numFrames;
+  // Not playing (deactivated), so just show the first frame
+  if (slot < 0)
+    return std::make_pair( currentAnim->getImage(), currentAnim->getImageFrame(currentDirection, 0) );
+  return std::make_pair( currentAnim->getImage(), AnimationSystem::getInstance().imageFrame[slot] );
 }
 
 bool AnimationState::hasFinished() const
 {
-  return currentAnim.second->loops() ? false : currentTime >= currentAnim.second->getNumFrames(currentDirection);
+  return currentAnim->loops() ? false : getCurrentTime() >= currentAnim->getNumFrames(currentDirection);
 }
@@ -2,53 +2,85 @@
 #define ANIMATIONSTATE_H
 
 #include "animation.h"
+#include "animationsystem.h"
 
 #include <string>
 
 class AnimationSet;
 class Image;
 
+// Which animation an actor is playing. The playback itself (time, frames,
+// sounds) lives in the AnimationSystem, which advances every active state at
+// once.
 class AnimationState
 {
  public:
   AnimationState();
   ~AnimationState() {}
 
-  void activate(const AnimationSet*, const std::string &startAnim);
-  void update(float delta);
+  void activate(const AnimationSet*, int startAnim);
+  void deactivate();
 
   bool hasFinished() const;
 
-  void setPlaySpeed(float s) { playSpeed = s; }
+  void setPlaySpeed(float s) { playSpeed = s; updateRate(); }
   float getPlaySpeed() const { return playSpeed; }
 
-  void playAnimation(const std::string&);
-  const std::string &getCurrentAnimName() const { return currentAnim.first; }
-  const Animation &getCurrentAnim() const { return *currentAnim.second; }
-  float getCurrentTime() const { return currentTime; }
+  // Holds the animation (and its sounds) where it is
+  void setPaused(bool p) { if (slot >= 0) AnimationSystem::getInstance().setPaused(slot, p); }
+
+  // Keeps playing, but without any sounds
+  void setMuted(bool m) { if (slot >= 0) AnimationSystem::getInstance().setMuted(slot, m); }
+
+  void playAnimation(int id);
+  int getCurrentAnimID() const { return currentID; }
+  const Animation &getCurrentAnim() const { return *currentAnim; }
+  float getCurrentTime() const { return slot >= 0 ? AnimationSystem::getInstance().time[slot] : 0.f; }
   
   void setDirection(Animation::Direction);
   Animation::Direction getDirection() const { return currentDirection; }
 
   const AnimationSet *getAnimSet() const { return animSet; }
 
+  // Where animation sounds come from in the world
+  void setSoundSource(const Vec2f *pos) { soundSource = pos; }
+
   std::pair<const Image*, unsigned> getDrawData() const;
 
+  // Where the animation is in its playback
+  struct Snapshot
+  {
+    Snapshot();
+    int anim, direction;
+    float playSpeed, time, soundTimer;
+    int frame, lastSound;
+    bool paused;
+    int slot; // So the system can update everyone in the same order again
+  };
+
+  void save(Snapshot&) const;
+  void restore(const Snapshot&); // Only while active
+
+  // Trades slots with whoever is in the given one
+  void moveToSlot(int s);
+
   AnimationState(const AnimationState&) = delete; 
   AnimationState &operator=(const AnimationState&) = delete;
   
  private:
+  friend class AnimationSystem;
+
   const AnimationSet *animSet;
+  int slot; // In the AnimationSystem, -1 while inactive
 
   // The current animation
-  std::pair<std::string, const Animation*> currentAnim; // Should never be null while active
-  float currentSoundInterval;
-  float currentTime;
+  int currentID;
+  const Animation *currentAnim; // Should never be null while active
   float playSpeed;
-  int lastSound;
   Animation::Direction currentDirection;
+  const Vec2f *soundSource;
 
-  void clampTime();
+  void updateRate();
 };
 
 #endif
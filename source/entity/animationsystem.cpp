@@ -0,0 +1,176 @@
+#include "animationsystem.h"
+#include "animationstate.h"
+#include "animation.h"
+
+#include <algorithm>
+
+AnimationSystem &AnimationSystem::getInstance()
+{
+  static AnimationSystem instance;
+  return instance;
+}
+
+AnimationSystem::AnimationSystem() :
+  count(0),
+  time(), rate(), running(), numFrames(), loop(),
+  soundTimer(), soundInterval(),
+  frame(), imageFrame(), direction(), lastSound(), muted(),
+  anims(),
+  owners(),
+  events()
+{}
+
+void AnimationSystem::grow()
+{
+  size_t size = std::max<size_t>(64, time.size()*2);
+  time.resize(size); rate.resize(size); running.resize(size); numFrames.resize(size); loop.resize(size);
+  soundTimer.resize(size); soundInterval.resize(size);
+  frame.resize(size); imageFrame.resize(size); direction.resize(size); lastSound.resize(size);
+  muted.resize(size);
+  anims.resize(size);
+  owners.resize(size);
+}
+
+int AnimationSystem::add(AnimationState *owner)
+{
+  if (count == (int)time.size()) grow();
+  int slot = count++;
+  owners[slot] = owner;
+  anims[slot] = nullptr;
+  time[slot] = rate[slot] = 0.f;
+  running[slot] = 1.f;
+  numFrames[slot] = 1.f;
+  loop[slot] = 0.f;
+  soundTimer[slot] = soundInterval[slot] = 0.f;
+  frame[slot] = imageFrame[slot] = direction[slot] = 0;
+  lastSound[slot] = -1;
+  muted[slot] = false;
+  return slot;
+}
+
+void AnimationSystem::remove(int slot)
+{
+  // Move the last slot into the hole to keep everything packed
+  int last = --count;
+  if (slot != last) {
+    time[slot] = time[last]; rate[slot] = rate[last]; running[slot] = running[last];
+    numFrames[slot] = numFrames[last]; loop[slot] = loop[last];
+    soundTimer[slot] = soundTimer[last]; soundInterval[slot] = soundInterval[last];
+    frame[slot] = frame[last]; imageFrame[slot] = imageFrame[last];
+    direction[slot] = direction[last]; lastSound[slot] = lastSound[last];
+    muted[slot] = muted[last];
+    anims[slot] = anims[last];
+    owners[slot] = owners[last];
+    owners[slot]->slot = slot;
+  }
+
+  // Forget about events of the removed slot and fix up the moved one's
+  dropEvents(slot);
+  for (Event &e : events) if (e.slot == last) e.slot = slot;
+}
+
+void AnimationSystem::swap(int a, int b)
+{
+  std::swap(time[a], time[b]); std::swap(rate[a], rate[b]); std::swap(running[a], running[b]);
+  std::swap(numFrames[a], numFrames[b]); std::swap(loop[a], loop[b]);
+  std::swap(soundTimer[a], soundTimer[b]); std::swap(soundInterval[a], soundInterval[b]);
+  std::swap(frame[a], frame[b]); std::swap(imageFrame[a], imageFrame[b]);
+  std::swap(direction[a], direction[b]); std::swap(lastSound[a], lastSound[b]);
+  std::swap(muted[a], muted[b]);
+  std::swap(anims[a], anims[b]);
+  std::swap(owners[a], owners[b]);
+  owners[a]->slot = a;
+  owners[b]->slot = b;
+
+  for (Event &e : events) {
+    if (e.slot == a) e.slot = b;
+    else if (e.slot == b) e.slot = a;
+  }
+}
+
+void AnimationSystem::dropEvents(int slot)
+{
+  events.erase(std::remove_if(events.begin(), events.end(), [slot](const Event &e) { return e.slot == slot; }),
+	       events.end());
+}
+
+void AnimationSystem::start(int slot, const Animation *anim, int dir)
+{
+  anims[slot] = anim;
+  time[slot] = 0.f;
+  loop[slot] = anim->loops() ? 1.f : 0.f;
+  soundTimer[slot] = 0.f;
+  soundInterval[slot] = anim->getSoundSet().getSoundInterval();
+  lastSound[slot] = -1;
+  frame[slot] = 0;
+  direction[slot] = dir;
+  numFrames[slot] = anim->getNumFrames(static_cast<Animation::Direction>(dir));
+  imageFrame[slot] = anim->getImageFrame(static_cast<Animation::Direction>(dir), 0);
+
+  if (!anim->getSoundSet().empty() && soundInterval[slot] < 0.f && !muted[slot])
+    queue(EVENT_START_SOUND, slot);
+}
+
+void AnimationSystem::setDirection(int slot, int dir)
+{
+  direction[slot] = dir;
+  numFrames[slot] = anims[slot]->getNumFrames(static_cast<Animation::Direction>(dir));
+  if (time[slot] > numFrames[slot])
+    time[slot] = loop[slot] > 0.f ? time[slot] - numFrames[slot]*(static_cast<unsigned>(time[slot]+.5f) / std::max(static_cast<unsigned>(numFrames[slot]), 1u)) : numFrames[slot];
+  frame[slot] = std::max(0, std::min(static_cast<int>(time[slot]), static_cast<int>(numFrames[slot])-1));
+  imageFrame[slot] = anims[slot]->getImageFrame(static_cast<Animation::Direction>(dir), frame[slot]);
+}
+
+void AnimationSystem::update(float delta)
+{
+  // Advance time and wrap or stop at the end
+  for (int i = 0; i < count; i++) {
+    float t = time[i] + delta * rate[i] * running[i], n = numFrames[i];
+    float wrapped = t - n*(static_cast<unsigned>(t+.5f) / std::max(static_cast<unsigned>(n), 1u));
+    time[i] = t > n ? (loop[i] > 0.f ? wrapped : n) : t;
+  }
+
+  for (int i = 0; i < count; i++) {
+    int f = std::max(0, std::min(static_cast<int>(time[i]), static_cast<int>(numFrames[i])-1));
+    if (f != frame[i]) {
+      frame[i] = f;
+      queue(EVENT_FRAME, i);
+    }
+  }
+
+  // Repeating sounds. Paused states hold their timers too.
+  for (int i = 0; i < count; i++) {
+    if (soundInterval[i] <= 0.f) continue;
+    if (soundTimer[i] < 0.f && running[i] > 0.f) {
+      if (!muted[i]) queue(EVENT_SOUND, i);
+      soundTimer[i] = soundInterval[i];
+    }
+    else soundTimer[i] -= delta * running[i];
+  }
+
+  for (const Event &e : events) {
+    int i = e.slot;
+    const SoundSet &soundSet = anims[i]->getSoundSet();
+    const Vec2f *source = owners[i]->soundSource;
+
+    switch (e.type) {
+    case EVENT_FRAME:
+      imageFrame[i] = anims[i]->getImageFrame(static_cast<Animation::Direction>(direction[i]), frame[i]);
+      break;
+
+    case EVENT_SOUND: {
+      if (soundSet.empty()) break;
+      int nextSound;
+      while ((nextSound = soundSet.randomSoundID()) == lastSound[i] && soundSet.count() > 1) {}
+      if (source != nullptr) soundSet.playSound(lastSound[i] = nextSound, *source);
+      else soundSet.playSound(lastSound[i] = nextSound);
+    } break;
+
+    case EVENT_START_SOUND:
+      if (source != nullptr) soundSet.playRandomSound(*source);
+      else soundSet.playRandomSound();
+      break;
+    }
+  }
+  events.clear();
+}
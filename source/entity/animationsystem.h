@@ -0,0 +1,84 @@
+#ifndef ANIMATIONSYSTEM_H
+#define ANIMATIONSYSTEM_H
+
+#include <vector>
+
+#include "../vector2.h"
+
+class Animation;
+class AnimationState;
+
+/*
+ * Owns the playback data of every active AnimationState in flat arrays and
+ * advances all of them in one pass per frame, after the entities have
+ * updated. Anything that has to reach outside of those arrays (working out
+ * which image frame to draw, playing sounds) is queued as an event during the
+ * pass and handled once it is done.
+ *
+ * Active states are kept packed at the front of the arrays. An AnimationState
+ * only holds the index of its slot, which changes when other states go away.
+ */
+class AnimationSystem
+{
+ public:
+  static AnimationSystem &getInstance();
+
+  void update(float delta);
+
+  int getActiveCount() const { return count; }
+
+  AnimationSystem(const AnimationSystem&) = delete;
+  AnimationSystem &operator=(const AnimationSystem&) = delete;
+
+ private:
+  friend class AnimationState;
+  AnimationSystem();
+
+  enum EventType
+  {
+    EVENT_FRAME,     // The frame of the animation changed
+    EVENT_SOUND,     // Time for the next sound of a repeating sound set
+    EVENT_START_SOUND // An animation with a one-shot sound started playing
+  };
+
+  struct Event
+  {
+    EventType type;
+    int slot;
+  };
+
+  int add(AnimationState*);
+  void remove(int slot);
+
+  // Trades two slots, so a restored snapshot can put them back in order
+  void swap(int a, int b);
+  void dropEvents(int slot);
+
+  // Sets up a slot to play an animation from the start
+  void start(int slot, const Animation*, int direction);
+
+  // Called when the direction changes, which may change the number of frames
+  void setDirection(int slot, int direction);
+
+  void setRate(int slot, float r) { rate[slot] = r; }
+  void setPaused(int slot, bool p) { running[slot] = p ? 0.f : 1.f; }
+  void setMuted(int slot, bool m) { muted[slot] = m; }
+  void queue(EventType type, int slot) { events.push_back(Event{type, slot}); }
+
+  int count;
+
+  // Per slot. Rate is the animation's speed times the play speed, and running
+  // is 0 while paused (1 otherwise) so paused states just don't move.
+  std::vector<float> time, rate, running, numFrames, loop;
+  std::vector<float> soundTimer, soundInterval;
+  std::vector<int> frame, imageFrame, direction, lastSound;
+  std::vector<char> muted; // Sounds keep their timing but don't get played
+  std::vector<const Animation*> anims;
+  std::vector<AnimationState*> owners;
+
+  std::vector<Event> events;
+
+  void grow();
+};
+
+#endif
@@ -3,105 +3,119 @@
 #include "../gameconfig.h"
 #include "../physicsmanager.h"
 #include "../image.h"
+#include "../random.h"
 
-ChunkExplosion::ChunkExplosion() : image(nullptr), frame(0), freeChunks(), activeChunks()
+ChunkManager &ChunkManager::getInstance()
 {
-  int total = GameConfig::getInstance()["chunkSplits"].toInt();
-  total = total*total;
-  while (total-- > 0) freeChunks.push_back(new Chunk());
+  static ChunkManager instance;
+  return instance;
 }
 
-ChunkExplosion::~ChunkExplosion()
+ChunkManager::ChunkManager() :
+  count(0),
+  capacity(GameConfig::getInstance().get().chunkPool),
+  splits(GameConfig::getInstance().get().chunkSplits),
+  posX(capacity), posY(capacity),
+  velX(capacity), velY(capacity),
+  offX(capacity), offY(capacity),
+  life(capacity), decay(capacity),
+  srcX(capacity), srcY(capacity),
+  images(capacity), frames(capacity),
+  rayX(capacity), rayY(capacity), dirX(capacity), dirY(capacity),
+  hitT(capacity), hitNX(capacity), hitNY(capacity)
+{}
+
+void ChunkManager::spawn(const Image *image, int frame, const Vec2f &position, const Vec2f &velocity)
 {
-  for (Chunk *c : freeChunks) delete c;
-  for (Chunk *c : activeChunks) delete c;
-}
-
-void ChunkExplosion::spawn(const Image *img, int f, const Vec2f &position, const Vec2f &velocity)
-{
-  image = img;
-  frame = f;
-
-  //int cx = image->getFrameCenterX(f),
-  //  cy = image->getFrameCenterY(f);;
-
-  int splitSize = GameConfig ::getInstance()["chunkSplits"].toInt();
-  float secSize = 1.f/splitSize;
+  float secSize = 1.f/splits;
 
   float xspeed = 1000, yspeed = 1300;
-
-  for (float x = 0; x < 1.f; x += secSize) {
-    for (float y = 0; y < 1.f; y += secSize) {
-      freeChunks.front()->reset( image, frame, position,
-				 Vec2f((x-.5f)*(xspeed + drand48()*xspeed), (y-.75f)*(yspeed+drand48()*yspeed)) + velocity, -1000+drand48()*2000,
-				 .5f + drand48()*.5,
-			       x, y, secSize, secSize);
-      activeChunks.push_front(freeChunks.front());
-      freeChunks.pop_front();
+  Random &random = Random::getInstance();
+
+  float cx = image->getFrameCenterX(frame), cy = image->getFrameCenterY(frame);
+  float fw = image->getFrameWidth(frame), fh = image->getFrameHeight(frame);
+
+  for (int ix = 0; ix < splits; ix++) {
+    for (int iy = 0; iy < splits && count < capacity; iy++) {
+      float x = ix * secSize, y = iy * secSize;
+      int i = count++;
+      posX[i] = position[0];
+      posY[i] = position[1];
+      velX[i] = (x-.5f)*(xspeed + random.real()*xspeed) + velocity[0];
+      velY[i] = (y-.75f)*(yspeed + random.real()*yspeed) + velocity[1];
+      offX[i] = cx + x * fw;
+      offY[i] = cy + y * fh;
+      life[i] = 1.f;
+      decay[i] = .5f + random.real()*.5;
+      srcX[i] = x;
+      srcY[i] = y;
+      images[i] = image;
+      frames[i] = frame;
     }
   }
 }
 
-void ChunkExplosion::update(float delta)
+void ChunkManager::update(float delta)
 {
-  for (auto it = activeChunks.begin(); it != activeChunks.end();) {
-    Chunk *c = *it;
-    if (!c->isAlive()) {
-      it = activeChunks.erase(it);
-      freeChunks.push_front(c);
-      continue;
+  // Throw out dead chunks first, keeping the order so explosions stay grouped
+  int alive = 0;
+  for (int i = 0; i < count; i++) {
+    if (life[i] <= 0.f) continue;
+    if (alive != i) {
+      posX[alive] = posX[i]; posY[alive] = posY[i];
+      velX[alive] = velX[i]; velY[alive] = velY[i];
+      offX[alive] = offX[i]; offY[alive] = offY[i];
+      life[alive] = life[i]; decay[alive] = decay[i];
+      srcX[alive] = srcX[i]; srcY[alive] = srcY[i];
+      images[alive] = images[i]; frames[alive] = frames[i];
     }
-    c->update(delta);
-    ++it;
+    alive++;
   }
-}
-
-void ChunkExplosion::draw(float scrollFactor) const
-{
-  for (Chunk *c : activeChunks) {
-    c->draw(scrollFactor);
+  count = alive;
+  if (count == 0) return;
+
+  // Integrate
+  const float gravity = PhysicsManager::GRAVITY * delta;
+  for (int i = 0; i < count; i++) {
+    life[i] -= delta * decay[i];
+    velY[i] += gravity;
+    rayX[i] = posX[i] + offX[i];
+    rayY[i] = posY[i] + offY[i];
+    dirX[i] = velX[i] * delta;
+    dirY[i] = velY[i] * delta;
   }
-}
-
-bool ChunkExplosion::isAlive() const { return activeChunks.size() > 0; }
 
-void Chunk::draw(float scroll) const
-{
-  image->drawChunk(position[0], position[1], frame,
-  		   sx, sy, sw, sh, std::max(life,0.f), scroll);
-  //image->draw(position[0], position[1], frame, scroll);
-}
-
-void Chunk::update(float delta)
-{
-  life -= delta * decaySpeed;
-  velocity += Vec2f(0,1) * PhysicsManager::GRAVITY * delta;
-
-  Vec2f pos = position + Vec2f(image->getFrameCenterX(frame) + sx * image->getFrameWidth(frame),
-			       image->getFrameCenterY(frame) + sy * image->getFrameHeight(frame));
-
-  Vec2f dir = velocity * delta;
-
-  auto result = PhysicsManager::getInstance().rayCast(PhysicsManager::MASK_WORLD,
-						      pos, pos+dir);
-  if (result.hit)
-    dir = (velocity = velocity.reflect(result.normal)*.5f) * delta;
-  
-  position += dir * .5;
+  // Bounce off of the world. All the rays go in at once so the physics manager
+  // only has to look up the segments of each grid cell a single time.
+  PhysicsManager::getInstance().rayCastBatch( PhysicsManager::MASK_WORLD, count,
+					       rayX.data(), rayY.data(), dirX.data(), dirY.data(),
+					       hitT.data(), hitNX.data(), hitNY.data() );
+
+  for (int i = 0; i < count; i++) {
+    if (hitT[i] < 1.f) {
+      float d = (velX[i]*hitNX[i] + velY[i]*hitNY[i]) * 2.f;
+      velX[i] = (velX[i] - hitNX[i]*d) * .5f;
+      velY[i] = (velY[i] - hitNY[i]*d) * .5f;
+      dirX[i] = velX[i] * delta;
+      dirY[i] = velY[i] * delta;
+    }
+    posX[i] += dirX[i] * .5f;
+    posY[i] += dirY[i] * .5f;
+  }
 }
 
- void Chunk::reset(const Image *img, int f, const Vec2f &pos, const Vec2f &vel, float av, float ds, float x, float y, float w, float h)
+void ChunkManager::draw(float scrollFactor) const
 {
-  image = img;
-  frame = f;
-  position = pos;
-  velocity = vel;
-  life = 1.f;
-  decaySpeed = ds;
-  angVel = av;
-  angle = 0.f;
-  sx = x;
-  sy = y;
-  sw = w;
-  sh = h;
+  float size = 1.f/splits;
+
+  // Hand each run of chunks that share an image frame over in one go
+  int start = 0;
+  for (int i = 1; i <= count; i++) {
+    if (i == count || images[i] != images[start] || frames[i] != frames[start]) {
+      images[start]->drawChunks( frames[start], size, i - start,
+				 &posX[start], &posY[start], &srcX[start], &srcY[start], &life[start],
+				 scrollFactor );
+      start = i;
+    }
+  }
 }
@@ -2,59 +2,58 @@
 #define CHUNKEXPLOSION_H
 
 /*
- * This is kind of hacked in here. I don't think I really plan to keep this
- * for the game, but
+ * Every dying actor gets split into little chunks that fly off and bounce
+ * around. Rather than each actor owning its own pile of chunks (even though
+ * almost none of them are dying at any given time), one global pool holds all
+ * of them in flat arrays so a whole crowd dying at once is just a longer loop.
  */
 
 #include "../vector2.h"
 
-#include <list>
+#include <vector>
 
 class Image;
 
-class Chunk
+class ChunkManager
 {
  public:
- Chunk() : image(nullptr), frame(0), life(0.f), decaySpeed(0.f), position(), velocity(), angle(0.f), angVel(0.f), sx(0.f), sy(0.f), sw(0.f), sh(0.f) {}
+  static ChunkManager &getInstance();
 
-  void update(float delta);
-  void reset(const Image*, int f, const Vec2f &pos, const Vec2f &vel, float av, float ds, float x, float y, float w, float h);
-  void draw(float scroll) const;
-
-  bool isAlive() { return life > 0.f; }
-  
- private:
-  const Image *image;
-  int frame;
-  float life;
-  float decaySpeed;
-  Vec2f position;
-  Vec2f velocity;
-  float angle;
-  float angVel;
-  float sx, sy, sw, sh;
-};
-
-class ChunkExplosion
-{
- public:
-  ChunkExplosion();
-  ~ChunkExplosion();
-
-  void spawn(const Image*, int f, const Vec2f &pos, const Vec2f &velocity);
+  // Splits a frame of the image into chunkSplits x chunkSplits pieces and throws
+  // them outwards from the given position. If the pool is full, the explosion
+  // gets fewer chunks instead of growing the pool.
+  void spawn(const Image*, int frame, const Vec2f &pos, const Vec2f &velocity);
 
-  void draw(float scrollFactor) const;
   void update(float delta);
+  void draw(float scrollFactor) const;
+
+  // Kills every chunk (i.e. when the scene changes)
+  void clear() { count = 0; }
 
-  bool isAlive() const;
+  int getActiveCount() const { return count; }
+  int getCapacity() const { return capacity; }
 
-  ChunkExplosion(const ChunkExplosion&) = delete;
-  ChunkExplosion &operator=(const ChunkExplosion&) = delete;
+  ChunkManager(const ChunkManager&) = delete;
+  ChunkManager &operator=(const ChunkManager&) = delete;
 
  private:
-  const Image *image; int frame;
-  std::list<Chunk*> freeChunks, activeChunks;
+  ChunkManager();
+
+  int count, capacity;
+  int splits;
+
+  // Chunk attributes, one array per attribute. Chunks of the same explosion
+  // stay next to each other, which lets draw() hand whole runs to the image.
+  std::vector<float> posX, posY;
+  std::vector<float> velX, velY;
+  std::vector<float> offX, offY; // offset from position to the chunk's center, for collision
+  std::vector<float> life, decay;
+  std::vector<float> srcX, srcY; // section of the frame (0 to 1) the chunk was cut from
+  std::vector<const Image*> images;
+  std::vector<int> frames;
+
+  // Scratch space for the collision pass
+  std::vector<float> rayX, rayY, dirX, dirY, hitT, hitNX, hitNY;
 };
 
-
 #endif
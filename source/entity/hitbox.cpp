@@ -4,7 +4,10 @@
 #include "../gamemanager.h"
 #include "../physicsmanager.h"
 #include "../stringutil.h"
+#include "../gameconfig.h"
+#include "../stats.h"
 #include "../entity.h"
+#include "../gamesnapshot.h"
 
 #include <iostream>
 
@@ -48,20 +51,50 @@ void HitBox::activate(const HitBoxModel* m, Entity *o, int hitMask, const Vec2f
   soundQueue = 0.f;
 }
 
-void HitBox::update(float delta)
+HitBox::Snapshot::Snapshot() :
+  ownerModel(), attack(-1), owner(-1), mask(0), life(0.f), position(), direction(Animation::DIR_RIGHT),
+  hitList(), soundQueue(0), soundTimer(-1.f) {}
+
+void HitBox::save(Snapshot &s, const EntityIDs &ids) const
+{
+  s.owner = ids.find(owner);
+  s.mask = mask;
+  s.life = life;
+  s.position = position;
+  s.direction = direction;
+  s.hitList.clear();
+  for (const Entity *e : hitList) s.hitList.push_back(ids.find(e));
+  s.soundQueue = soundQueue;
+  s.soundTimer = soundTimer;
+}
+
+void HitBox::restore(const Snapshot &s, const HitBoxModel *m, const EntityIDs &ids)
+{
+  model = m;
+  owner = ids.get(s.owner);
+  mask = s.mask;
+  life = s.life;
+  position = s.position;
+  direction = static_cast<Animation::Direction>(s.direction);
+  hitList.clear();
+  for (int id : s.hitList) if (ids.get(id) != nullptr) hitList.push_back(ids.get(id));
+  soundQueue = s.soundQueue;
+  soundTimer = s.soundTimer;
+}
+
+void HitBox::update(float delta, bool precise)
 {
-  if (owner != nullptr) {
+  if (owner != nullptr && owner->isAlive())
     position = owner->getPosition();
-  } else if (!owner->isAlive())
-    owner = nullptr;
 
   Vec2f realPos = position + Vec2f(model->getOffset()[0] * (direction == Animation::DIR_RIGHT ? 1.f : -1.f), model->getOffset()[1]);
 
   if (life > 0.f) {
     PhysicsManager &physics = PhysicsManager::getInstance();
-    physics.queryEntityGridArea( realPos, 1, mask, [&realPos, this](Entity *e) {
+    physics.queryEntityGridArea( realPos, 1, mask, [&realPos, precise, this](Entity *e) {
 	if ( std::find(hitList.begin(), hitList.end(), e) == hitList.end() &&
-	     PhysicsManager::boxCircleIntersection( e->getBoundingBox(), realPos, model->getRadius() ) ) {
+	     PhysicsManager::boxCircleIntersection( e->getBoundingBox(), realPos, model->getRadius() ) &&
+	     (!precise || e->shapeCircleIntersection( realPos, model->getRadius() )) ) {
 	  e->registerHitBoxCollision(this);
 	  hitList.push_back(e);
 
@@ -76,7 +109,7 @@ void HitBox::update(float delta)
   if (soundTimer > 0.f)
     soundTimer -= delta;
   else if (soundQueue > 0) {
-    model->playSound();
+    model->playSound(position);
     soundQueue--;
     soundTimer = 0.03f;
   }
@@ -93,7 +126,10 @@ HitBoxFactory &HitBoxFactory::getInstance()
   return instance;
 }
 
-HitBoxFactory::HitBoxFactory() : freeList(), activeList() {}
+HitBoxFactory::HitBoxFactory() :
+  freeList(), activeList(), settings(GameConfig::getInstance().get()),
+  statActive(Stats::getInstance().add("hitboxes.active", Stats::GAUGE)),
+  statFree(Stats::getInstance().add("hitboxes.free", Stats::GAUGE)) {}
 
 HitBoxFactory::~HitBoxFactory()
 {
@@ -101,7 +137,7 @@ HitBoxFactory::~HitBoxFactory()
   for (HitBox *hb : activeList) delete hb;
 }
 
-void HitBoxFactory::spawnHitBox(const HitBoxModel* model, Entity *owner, int hitMask, const Vec2f &pos, Animation::Direction dir)
+HitBox *HitBoxFactory::take()
 {
   HitBox *hb;
   
@@ -112,15 +148,32 @@ void HitBoxFactory::spawnHitBox(const HitBoxModel* model, Entity *owner, int hit
     freeList.pop_front();
   }
 
-  hb->activate(model, owner, hitMask, pos, dir);
   activeList.push_front(hb);
+  return hb;
+}
+
+void HitBoxFactory::spawnHitBox(const HitBoxModel* model, Entity *owner, int hitMask, const Vec2f &pos, Animation::Direction dir)
+{
+  take()->activate(model, owner, hitMask, pos, dir);
+}
+
+HitBox *HitBoxFactory::restoreHitBox(const HitBox::Snapshot &s, const HitBoxModel *model, const EntityIDs &ids)
+{
+  HitBox *hb = take();
+  hb->restore(s, model, ids);
+  return hb;
+}
+
+void HitBoxFactory::clear()
+{
+  freeList.splice(freeList.begin(), activeList);
 }
 
 void HitBoxFactory::updateActiveList(float delta)
 {
   for (auto it = activeList.begin(); it != activeList.end();) {
     if ((*it)->alive()) {
-      (*it++)->update(delta);
+      (*it++)->update(delta, settings.preciseHitBoxes);
     }
     else {
       freeList.push_front(*it);
@@ -128,8 +181,9 @@ void HitBoxFactory::updateActiveList(float delta)
     }
   }
 
-  // DEBUG STUFF
-  GameManager::getInstance().setDebugMessage(4, "HitBox Pool: " + StringUtil::toString(activeList.size()) + " / " + StringUtil::toString(freeList.size()) );
+  Stats &stats = Stats::getInstance();
+  stats.set(statActive, activeList.size());
+  stats.set(statFree, freeList.size());
 }
 
 void HitBoxFactory::debugDraw() const
@@ -9,6 +9,8 @@
 #include <list>
 
 class Entity;
+class EntityIDs;
+struct Settings;
 
 class HitBoxModel
 {
@@ -19,7 +21,7 @@ class HitBoxModel
   float getLife() const { return life; }
   float getRadius() const { return radius; }
   const Vec2f &getOffset() const { return offset; }
-  void playSound() const { if (!soundSet.empty()) soundSet.playRandomSound(); }
+  void playSound(const Vec2f &pos) const { if (!soundSet.empty()) soundSet.playRandomSound(pos); }
   float getDamage() const { return damage; }
   float getImpact() const { return impact; }
 
@@ -43,13 +45,33 @@ class HitBox
   ~HitBox();
 
   void activate(const HitBoxModel* m, Entity*o, int hitMask, const Vec2f &pos, Animation::Direction dir);
-  void update(float delta);
+  void update(float delta, bool precise);
   bool alive() const { return life > 0 || soundQueue > 0; }
   
   const HitBoxModel *getModel() const { return model; }
   const Vec2f &getPosition() const { return position; }
   Animation::Direction getDirection() const { return direction; }
 
+  // The model is kept as the actor model and attack it belongs to, which the
+  // GameManager works out
+  struct Snapshot
+  {
+    Snapshot();
+    std::string ownerModel;
+    int attack;
+    int owner;
+    int mask;
+    float life;
+    Vec2f position;
+    int direction;
+    std::vector<int> hitList;
+    int soundQueue;
+    float soundTimer;
+  };
+
+  void save(Snapshot&, const EntityIDs&) const;
+  void restore(const Snapshot&, const HitBoxModel*, const EntityIDs&);
+
   HitBox(const HitBox&) = delete;
   HitBox &operator=(const HitBox&) = delete;
   
@@ -74,12 +96,29 @@ class HitBoxFactory
 
   void updateActiveList(float delta);
 
+  // Newest first, like they're updated
+  const std::list<HitBox*> &getActiveList() const { return activeList; }
+
+  // Takes a hit box out of the free list for a snapshot to fill in
+  HitBox *restoreHitBox(const HitBox::Snapshot&, const HitBoxModel*, const EntityIDs&);
+
+  void clear();
+
   void debugDraw() const;
   
  private:
   HitBoxFactory();
   ~HitBoxFactory();
   std::list<HitBox*> freeList, activeList;
+
+  // Out of the free list (or new) and onto the front of the active list
+  HitBox *take();
+
+  // For preciseHitBoxes: test against the target's animation frame shape, not
+  // just its bounding box
+  const Settings &settings;
+
+  int statActive, statFree;
 };
 
 #endif
@@ -0,0 +1,55 @@
+#include "perceptionscheduler.h"
+
+#include "../gameconfig.h"
+#include "../viewport.h"
+#include "../random.h"
+#include <algorithm>
+
+PerceptionScheduler &PerceptionScheduler::getInstance()
+{
+  static PerceptionScheduler instance;
+  return instance;
+}
+
+PerceptionScheduler::PerceptionScheduler() :
+  settings(GameConfig::getInstance().get().perception),
+  checks(0),
+  deferred(0),
+  sightCast(0),
+  sightReused(0)
+{}
+
+void PerceptionScheduler::beginFrame()
+{
+  checks = 0;
+  deferred = 0;
+  sightCast = 0;
+  sightReused = 0;
+}
+
+bool PerceptionScheduler::shouldCheck(float &timer, float rate, const Vec2f &position, float delta)
+{
+  if ((timer -= delta) > 0.f) return false;
+
+  // Out of checks this frame. Stay due so we go first next frame.
+  if (checks >= settings.budget) {
+    deferred++;
+    return false;
+  }
+  checks++;
+
+  // Think less often the farther away from the view we are
+  float dist = (position - Viewport::getInstance().getPosition()).length();
+  float interval = rate > 0.f ? 1.f / rate : 0.f;
+  if (dist > settings.farDist) interval *= 4.f;
+  else if (dist > settings.nearDist) interval *= 2.f;
+
+  // Keep our place in the schedule unless we fell far behind
+  timer = std::max(timer + interval, interval * .5f);
+  return true;
+}
+
+float PerceptionScheduler::randomPhase(float rate) const
+{
+  return rate > 0.f ? Random::getInstance().real() / rate : 0.f;
+}
@@ -0,0 +1,57 @@
+#ifndef PERCEPTIONSCHEDULER_H
+#define PERCEPTIONSCHEDULER_H
+
+#include "../vector2.h"
+#include "../gameconfig.h"
+
+/*
+ * Decides which enemies get to look for the player on a given frame. Looking
+ * means a grid query plus intersection tests, so rather than every enemy doing
+ * it every frame, each one looks a few times per second (set by its behavior),
+ * less often the farther it is from the view, and only so many of them get to
+ * look in a single frame.
+ */
+class PerceptionScheduler
+{
+ public:
+  static PerceptionScheduler &getInstance();
+
+  // Resets the per-frame budget. Called once at the start of every frame.
+  void beginFrame();
+
+  // Counts down an enemy's perception timer. Returns true if the enemy should
+  // look around this frame, in which case the timer is wound back up. A rate
+  // of 0 or less means every frame (budget permitting).
+  bool shouldCheck(float &timer, float rate, const Vec2f &position, float delta);
+
+  // A random starting timer so enemies spawned together don't all look on the same frame
+  float randomPhase(float rate) const;
+
+  // Line of sight results are reused until they are this old (in seconds) or
+  // either end has moved farther than this
+  float getSightCacheTime() const { return settings.sightCacheTime; }
+  float getSightCacheMove() const { return settings.sightCacheMove; }
+
+  // For the debug HUD
+  void countSightTest(bool cached) { cached ? sightReused++ : sightCast++; }
+
+  int getChecks() const { return checks; }
+  int getDeferred() const { return deferred; }
+  int getSightCast() const { return sightCast; }
+  int getSightReused() const { return sightReused; }
+
+  PerceptionScheduler(const PerceptionScheduler&) = delete;
+  PerceptionScheduler &operator=(const PerceptionScheduler&) = delete;
+
+ private:
+  PerceptionScheduler();
+
+  // Most checks allowed in a single frame (the rest wait for the next one).
+  // Past nearDist from the view, enemies look half as often. Past farDist, a quarter.
+  const Settings::Perception &settings;
+
+  int checks, deferred;
+  int sightCast, sightReused;
+};
+
+#endif
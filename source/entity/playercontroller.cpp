@@ -131,8 +131,8 @@ void PlayerController::update(float delta)
   if (physics.getVisibleState() == ActorPhysics::STATE_GROUND
       || (physics.getVisibleState() == ActorPhysics::STATE_AIR && jumpExceptionTimer > 0.f) ) {
     if (jumping && jumpState == JUMP_NONE) {
-      if (actor->getAnimationState().getCurrentAnimName() == "jump")
-	actor->getAnimationState().playAnimation("jump");
+      if (actor->getAnimationState().getCurrentAnimID() == actor->getAnimID(Actor::ANIM_JUMP))
+	actor->getAnimationState().playAnimation(actor->getAnimID(Actor::ANIM_JUMP));
       actor->jump(1.f);
       jumpState = JUMP_BEGIN;
       hopTimer = HOP_TIME;// - delta;
@@ -58,11 +58,25 @@ const EntityModel *EntityFactory::getModel(const std::string &modelName)
   return result == models.end() ? loadModelXML(modelName) : result->second;
 }
 
+const std::string &EntityFactory::getModelName(const EntityModel *model) const
+{
+  for (auto &it : models) if (it.second == model) return it.first;
+  throw std::string("EntityFactory '" + type + "' didn't load that model");
+}
+
 EntityModel *EntityFactory::loadModelXML(const std::string &modelName)
 {
-  XMLParser parser("assets/" + type + "/" + modelName + ".xml");
+  std::string file = "assets/" + type + "/" + modelName + ".xml";
+  XMLParser parser(file);
 
   // Inside the XML file, we simply look for the first "root tag" that is
   // the type of the model. (i.e. <enemy> or <backdrop>)
-  return models[modelName] = createModel(parser.getTag(type));
+  EntityModel *model;
+  try {
+    model = createModel(parser.getTag(type));
+  }
+  catch (const std::string &e) {
+    throw std::string("Couldn't load " + file + ": " + e);
+  }
+  return models[modelName] = model;
 }
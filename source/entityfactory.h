@@ -25,6 +25,9 @@ class EntityFactory
   void updateActiveList(float delta);
 
   int getActiveCount() const { return activeList.size(); }
+
+  // Newest first, which is also the order they're updated in
+  const std::list<Entity*> &getActiveList() const { return activeList; }
   int getFreeCount() const { return freeList.size(); }
 
   // Returns the name for the type of entity the factory is handling. This is mostly
@@ -34,6 +37,10 @@ class EntityFactory
   // Attempts to load a model data file (right now it's XML)
   const EntityModel *getModel(const std::string &modelName);
 
+  // The name a loaded model was loaded by
+  const std::string &getModelName(const EntityModel*) const;
+  const std::unordered_map<std::string, EntityModel*> &getModels() const { return models; }
+
   EntityFactory(const EntityFactory&) = delete;
   EntityFactory &operator=(const EntityFactory&) = delete;
   
@@ -0,0 +1,168 @@
+#ifndef FRAMEFILE_H
+#define FRAMEFILE_H
+
+/*
+ * The '.frame' file that goes with a sprite sheet: where each frame sits on
+ * the sheet, its center, and the outline of its collision shape.
+ *
+ * Version 2, everything little-endian:
+ *
+ *   header, 16 bytes
+ *     char[4]  magic "FRM2"
+ *     u16      version (2)
+ *     u16      frame count
+ *     u32      vertex count
+ *     u32      checksum (FNV-1a of everything after the header)
+ *   frame table, 20 bytes per frame
+ *     u16      x, y, w, h
+ *     i16      center x, center y
+ *     u32      first vertex, vertex count
+ *   vertex table, 8 bytes per vertex
+ *     f32      x, y
+ *
+ * Version 1 files (a u16 frame count, then for every frame six u16s, a u32
+ * vertex count and that many float pairs, in the byte order of whoever wrote
+ * them) are still read, assuming a little-endian writer.
+ *
+ * Everything is in this header so spritegen and the converter can use it
+ * without linking against the game.
+ */
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+struct FrameRecord
+{
+  unsigned short x, y, w, h;
+  short ox, oy;
+  unsigned firstVertex, vertexCount;
+};
+
+class FrameFile
+{
+ public:
+  FrameFile() : frames(), vertices() {}
+
+  std::vector<FrameRecord> frames;
+  std::vector<float> vertices; // x, y pairs. Frames index pairs, not floats.
+
+  static const unsigned VERSION = 2;
+  static const size_t HEADER_SIZE = 16, FRAME_SIZE = 20, VERTEX_SIZE = 8;
+
+  static bool isVersion2(const unsigned char *data, size_t size) {
+    return size >= 4 && memcmp(data, "FRM2", 4) == 0; }
+
+  // Reads either version. Throws a string if the data is cut short, fails the
+  // checksum, or points outside of itself.
+  void decode(const unsigned char *data, size_t size, const std::string &name) {
+    if (isVersion2(data, size)) decodeV2(data, size, name);
+    else decodeV1(data, size, name);
+  }
+
+  std::vector<unsigned char> encode() const {
+    std::vector<unsigned char> out;
+    out.reserve(HEADER_SIZE + frames.size()*FRAME_SIZE + vertices.size()/2*VERTEX_SIZE);
+    for (char c : {'F','R','M','2'}) out.push_back(c);
+    put16(out, VERSION);
+    put16(out, frames.size());
+    put32(out, vertices.size()/2);
+    put32(out, 0); // checksum, filled in below
+
+    for (const FrameRecord &f : frames) {
+      put16(out, f.x); put16(out, f.y); put16(out, f.w); put16(out, f.h);
+      put16(out, static_cast<unsigned short>(f.ox)); put16(out, static_cast<unsigned short>(f.oy));
+      put32(out, f.firstVertex); put32(out, f.vertexCount);
+    }
+    for (float v : vertices) {
+      unsigned bits;
+      memcpy(&bits, &v, sizeof(float));
+      put32(out, bits);
+    }
+
+    unsigned sum = checksum(out.data() + HEADER_SIZE, out.size() - HEADER_SIZE);
+    for (int i = 0; i < 4; i++) out[12+i] = (sum >> (i*8)) & 0xff;
+    return out;
+  }
+
+  static unsigned checksum(const unsigned char *data, size_t size) {
+    unsigned hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+      hash ^= data[i];
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+
+ private:
+  static void put16(std::vector<unsigned char> &out, unsigned v) {
+    out.push_back(v & 0xff);
+    out.push_back((v >> 8) & 0xff);
+  }
+  static void put32(std::vector<unsigned char> &out, unsigned v) {
+    for (int i = 0; i < 4; i++) out.push_back((v >> (i*8)) & 0xff);
+  }
+  static unsigned get16(const unsigned char *p) { return p[0] | p[1] << 8; }
+  static unsigned get32(const unsigned char *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | static_cast<unsigned>(p[3]) << 24; }
+  static float getFloat(const unsigned char *p) {
+    unsigned bits = get32(p);
+    float f;
+    memcpy(&f, &bits, sizeof(float));
+    return f;
+  }
+
+  void decodeV2(const unsigned char *data, size_t size, const std::string &name) {
+    if (size < HEADER_SIZE) throw std::string("Frame file " + name + " is too short");
+    if (get16(data+4) != VERSION) throw std::string("Frame file " + name + " has an unknown version");
+
+    unsigned frameCount = get16(data+6), vertexCount = get32(data+8);
+    if (size != HEADER_SIZE + frameCount*FRAME_SIZE + static_cast<size_t>(vertexCount)*VERTEX_SIZE)
+      throw std::string("Frame file " + name + " has the wrong size");
+    if (checksum(data + HEADER_SIZE, size - HEADER_SIZE) != get32(data+12))
+      throw std::string("Frame file " + name + " is corrupt (bad checksum)");
+
+    frames.resize(frameCount);
+    const unsigned char *p = data + HEADER_SIZE;
+    for (FrameRecord &f : frames) {
+      f.x = get16(p); f.y = get16(p+2); f.w = get16(p+4); f.h = get16(p+6);
+      f.ox = static_cast<short>(get16(p+8)); f.oy = static_cast<short>(get16(p+10));
+      f.firstVertex = get32(p+12); f.vertexCount = get32(p+16);
+      if (f.firstVertex > vertexCount || f.vertexCount > vertexCount - f.firstVertex)
+	throw std::string("Frame file " + name + " has a frame with vertices out of range");
+      p += FRAME_SIZE;
+    }
+
+    vertices.resize(vertexCount*2);
+    for (float &v : vertices) {
+      v = getFloat(p);
+      p += 4;
+    }
+  }
+
+  void decodeV1(const unsigned char *data, size_t size, const std::string &name) {
+    const unsigned char *p = data, *end = data + size;
+    auto need = [&p, end, &name](size_t bytes) {
+      if (static_cast<size_t>(end - p) < bytes) throw std::string("Frame file " + name + " is cut short"); };
+
+    need(2);
+    frames.resize(get16(p));
+    p += 2;
+    vertices.clear();
+
+    for (FrameRecord &f : frames) {
+      need(16);
+      f.x = get16(p); f.y = get16(p+2); f.w = get16(p+4); f.h = get16(p+6);
+      f.ox = static_cast<short>(get16(p+8)); f.oy = static_cast<short>(get16(p+10));
+      f.firstVertex = vertices.size()/2;
+      f.vertexCount = get32(p+12);
+      p += 16;
+
+      need(static_cast<size_t>(f.vertexCount)*8);
+      for (unsigned v = 0; v < f.vertexCount*2; v++, p += 4)
+	vertices.push_back(getFloat(p));
+    }
+  }
+};
+
+#endif
@@ -1,4 +1,157 @@
 #include "gameconfig.h"
+#include "xmlparser.h"
+
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+
+namespace {
+
+const float POLL_INTERVAL = 1.f;
+
+// Reads values out of the config tree by path ("perception/budget"). Missing
+// ones get their default, and anything that doesn't parse or is out of range
+// is collected as a problem. While reloading, settings that aren't live are
+// left alone.
+class SettingsReader
+{
+ public:
+  SettingsReader(const XMLTag &r, bool reload) : root(r), reloading(reload), problems() {}
+
+  template <typename T>
+  void read(const std::string &path, T &value, T def, T min, T max, bool live = false) {
+    if (reloading && !live) return;
+    const XMLTag *tag = find(path);
+    if (tag == nullptr) { value = def; return; }
+
+    std::istringstream in(tag->toStr());
+    T v;
+    if (!(in >> v) || !(in >> std::ws).eof())
+      problems.push_back(path + " should be a number, not '" + tag->toStr() + "'");
+    else if (v < min || v > max)
+      problems.push_back(path + " should be between " + toStr(min) + " and " + toStr(max));
+    else value = v;
+  }
+
+  void read(const std::string &path, bool &value, bool def, bool live = false) {
+    if (reloading && !live) return;
+    const XMLTag *tag = find(path);
+    if (tag == nullptr) { value = def; return; }
+
+    const std::string &s = tag->toStr();
+    if (s == "true" || s == "1") value = true;
+    else if (s == "false" || s == "0") value = false;
+    else problems.push_back(path + " should be true or false, not '" + s + "'");
+  }
+
+  void read(const std::string &path, std::string &value, const std::string &def, bool live = false) {
+    if (reloading && !live) return;
+    const XMLTag *tag = find(path);
+    value = tag != nullptr ? tag->toStr() : def;
+  }
+
+  void read(const std::string &path, Settings::Color &value, const Settings::Color &def, bool live = false) {
+    read(path + "/r", value.r, def.r, 0, 255, live);
+    read(path + "/g", value.g, def.g, 0, 255, live);
+    read(path + "/b", value.b, def.b, 0, 255, live);
+    read(path + "/a", value.a, def.a, 0, 255, live);
+  }
+
+  void readLines(const std::string &path, std::vector<std::string> &lines, bool live = false) {
+    if (reloading && !live) return;
+    lines.clear();
+    const XMLTag *tag = find(path);
+    if (tag == nullptr) return;
+    for (const XMLTag *t : tag->getChildren()) lines.push_back(t->toStr());
+  }
+
+  const std::vector<std::string> &getProblems() const { return problems; }
+
+  SettingsReader(const SettingsReader&) = delete;
+  SettingsReader &operator=(const SettingsReader&) = delete;
+
+ private:
+  const XMLTag &root;
+  bool reloading;
+  std::vector<std::string> problems;
+
+  const XMLTag *find(const std::string &path) const {
+    const XMLTag *tag = &root;
+    std::istringstream in(path);
+    for (std::string name; std::getline(in, name, '/');) {
+      if (!tag->hasChild(name)) return nullptr;
+      tag = &(*tag)[name];
+    }
+    return tag;
+  }
+
+  template <typename T>
+  static std::string toStr(T v) { std::ostringstream out; out << v; return out.str(); }
+};
+
+// The schema. Everything the engine reads from config.xml is listed here.
+void readSettings(SettingsReader &r, Settings &s)
+{
+  r.read("title", s.title, "Game");
+  r.read("author", s.author, "");
+
+  r.read("frameCapOn", s.frameCapOn, true, true);
+  r.read("frameCap", s.frameCap, 300, 1, 10000, true);
+  r.read("vsync", s.vsync, true);
+
+  r.read("chunkSplits", s.chunkSplits, 4, 1, 64);
+  r.read("chunkPool", s.chunkPool, 16384, 0, 1<<22);
+
+  r.read("maxVoices", s.maxVoices, 24, 1, 256);
+  r.read("soundCacheKB", s.soundCacheKB, 32768, 0, 1<<22);
+
+  Settings::Perception &p = s.perception;
+  r.read("perception/budget", p.budget, 32, 1, 100000, true);
+  r.read("perception/near", p.nearDist, 2500.f, 0.f, 1e6f, true);
+  r.read("perception/far", p.farDist, 6000.f, 0.f, 1e6f, true);
+  r.read("perception/sightCacheTime", p.sightCacheTime, .5f, 0.f, 60.f, true);
+  r.read("perception/sightCacheMove", p.sightCacheMove, 48.f, 0.f, 1e6f, true);
+
+  Settings::Navigation &n = s.navigation;
+  r.read("navigation/spanGap", n.spanGap, 8.f, 0.f, 1e4f);
+  r.read("navigation/edgeMargin", n.edgeMargin, 32.f, 0.f, 1e4f);
+  r.read("navigation/clearance", n.clearance, 24.f, 0.f, 1e4f);
+  r.read("navigation/maxLinkDist", n.maxLinkDist, 1500.f, 0.f, 1e6f);
+
+  r.read("streaming/loadDist", s.streaming.loadDist, 6000.f, 0.f, 1e6f, true);
+  r.read("streaming/unloadDist", s.streaming.unloadDist, 9000.f, 0.f, 1e6f, true);
+
+  r.read("collision/weldDist", s.collision.weldDist, 1.f, 0.f, 64.f);
+  r.read("collision/mergeDist", s.collision.mergeDist, .5f, 0.f, 64.f);
+  r.read("collision/maxLength", s.collision.maxLength, 512.f, 1.f, 1024.f); // Two physics grid cells
+
+  r.read("activity/sleepDist", s.activity.sleepDist, 7000.f, 0.f, 1e6f, true);
+  r.read("activity/wakeDist", s.activity.wakeDist, 6500.f, 0.f, 1e6f, true);
+  r.read("activity/lodMargin", s.activity.lodMargin, 512.f, 0.f, 1e6f, true);
+  r.read("activity/lodRate", s.activity.lodRate, 15.f, 0.f, 1000.f, true);
+
+  r.read("preciseHitBoxes", s.preciseHitBoxes, true, true);
+
+  r.read("view/width", s.view.width, 1920, 1, 16384);
+  r.read("view/height", s.view.height, 1080, 1, 16384);
+  r.read("view/fullscreen", s.view.fullscreen, false);
+
+  r.read("font/file", s.font.file, "fonts/arial.ttf");
+  r.read("font/size", s.font.size, 24, 1, 512);
+  r.read("font/red", s.font.color.r, 255, 0, 255);
+  r.read("font/green", s.font.color.g, 255, 0, 255);
+  r.read("font/blue", s.font.color.b, 255, 0, 255);
+  r.read("font/alpha", s.font.color.a, 255, 0, 255);
+
+  r.read("debug/textColor", s.debug.textColor, {255, 100, 100, 255}, true);
+  r.read("debug/backColor", s.debug.backColor, {0, 0, 0, 128}, true);
+  r.read("debug/outlineColor", s.debug.outlineColor, {255, 255, 255, 255}, true);
+  r.read("debug/refreshRate", s.debug.refreshRate, 4.f, .1f, 1000.f, true);
+
+  r.readLines("directions", s.directions);
+}
+
+}
 
 GameConfig &GameConfig::getInstance()
 {
@@ -7,9 +160,55 @@ GameConfig &GameConfig::getInstance()
 }
 
 GameConfig::GameConfig() :
-  parser("xmlSpec/config.xml") {}
+  filename("xmlSpec/config.xml"),
+  settings(),
+  version(0),
+  modified(0),
+  pollTimer(0.f)
+{
+  load(false);
+}
+
+void GameConfig::load(bool reloading)
+{
+  modified = getModifiedTime();
+
+  XMLParser parser(filename);
+  SettingsReader reader(parser.getTag("Configuration"), reloading);
+
+  // Read into a copy so a bad file doesn't leave half of its values behind
+  Settings loaded = settings;
+  readSettings(reader, loaded);
+
+  if (!reader.getProblems().empty()) {
+    std::string msg = "Problems in " + filename + ":";
+    for (const std::string &p : reader.getProblems()) msg += "\n  " + p;
+    throw msg;
+  }
+
+  settings = loaded;
+  version++;
+}
+
+void GameConfig::update(float delta)
+{
+  pollTimer -= delta;
+  if (pollTimer > 0.f) return;
+  pollTimer = POLL_INTERVAL;
+
+  if (getModifiedTime() == modified) return;
+  try {
+    load(true);
+    std::cout << "Reloaded " << filename << std::endl;
+  }
+  catch (const std::string &msg) {
+    std::cout << msg << std::endl << "Keeping the settings from before" << std::endl;
+  }
+}
 
-const XMLTag &GameConfig::operator[](const std::string& name) const
+time_t GameConfig::getModifiedTime() const
 {
-  return parser.getTag("Configuration")[name];
+  struct stat info;
+  if (stat(filename.c_str(), &info) != 0) return modified;
+  return info.st_mtime;
 }
@@ -2,21 +2,127 @@
 #define GAMECONFIG_H
 
 #include <string>
+#include <vector>
+#include <ctime>
 
-#include "xmlparser.h"
+/*
+ * Every setting in xmlSpec/config.xml, read and checked once at startup so
+ * nobody has to look them up by name or parse them again. What each one is
+ * called in the file, its default and its allowed range are all listed in
+ * one place in gameconfig.cpp.
+ *
+ * Some settings are live: when config.xml is saved while the game runs, they
+ * are read again and show up right away. The rest (window size, pool sizes and
+ * such) need a restart.
+ */
+struct Settings
+{
+  Settings() :
+    title(), author(), frameCapOn(), frameCap(), vsync(), chunkSplits(), chunkPool(),
+    maxVoices(), soundCacheKB(), perception(), navigation(), streaming(), collision(), activity(), preciseHitBoxes(),
+    view(), font(), debug(), directions() {}
+
+  struct Color
+  {
+    int r, g, b, a;
+  };
+
+  std::string title, author;
+
+  bool frameCapOn;        // live
+  int frameCap;           // live
+  bool vsync;
+
+  int chunkSplits;
+  int chunkPool;
+
+  int maxVoices;
+  int soundCacheKB;
+
+  struct Perception
+  {
+    int budget;           // live
+    float nearDist, farDist;                 // live
+    float sightCacheTime, sightCacheMove;    // live
+  } perception;
+
+  struct Navigation
+  {
+    float spanGap, edgeMargin, clearance, maxLinkDist;
+  } navigation;
+
+  struct Streaming
+  {
+    float loadDist, unloadDist;              // live
+  } streaming;
+
+  struct Collision
+  {
+    float weldDist, mergeDist, maxLength;
+  } collision;
+
+  struct Activity
+  {
+    float sleepDist, wakeDist;               // live
+    float lodMargin, lodRate;                  // live
+  } activity;
+
+  bool preciseHitBoxes;   // live
 
-class XMLParser;
+  struct View
+  {
+    int width, height;
+    bool fullscreen;
+  } view;
+
+  struct Font
+  {
+    Font() : file(), size(), color() {}
+    std::string file;
+    int size;
+    Color color;
+  } font;
+
+  struct Debug
+  {
+    Color textColor, backColor, outlineColor; // live
+    float refreshRate;                        // live
+  } debug;
+
+  std::vector<std::string> directions;
+};
 
 class GameConfig
 {
  public:
   static GameConfig &getInstance();
 
-  const XMLTag &operator[](const std::string&) const;
-  
+  const Settings &get() const { return settings; }
+
+  // Checks config.xml every so often and reads the live settings again if it
+  // has been saved since. A file that doesn't parse or check out is reported
+  // and ignored, keeping the settings from before.
+  void update(float delta);
+
+  // Goes up every time the settings are reloaded
+  int getVersion() const { return version; }
+
+  GameConfig(const GameConfig&) = delete;
+  GameConfig &operator=(const GameConfig&) = delete;
+
  private:
   GameConfig();
-  XMLParser parser;
+
+  const std::string filename;
+  Settings settings;
+  int version;
+
+  time_t modified;
+  float pollTimer;
+
+  // Fills in settings from the file. When reloading, only the live ones.
+  void load(bool reloading);
+  time_t getModifiedTime() const;
 };
 
 #endif
@@ -9,17 +9,29 @@
 #include "lightmanager.h"
 #include "imagefactory.h"
 #include "gameconfig.h"
+#include "xmlparser.h"
 #include "clock.h"
 #include "viewport.h"
 #include "stringutil.h"
+#include "soundmanager.h"
+#include "stats.h"
+#include "random.h"
+#include "gamesnapshot.h"
+#include "scenestreamer.h"
 
 #include "entity/actor.h"
 #include "entity/actormodel.h"
 #include "entity/hitbox.h" // soon to be just factory
+#include "entity/chunkexplosion.h"
+#include "entity/perceptionscheduler.h"
+#include "entity/animationsystem.h"
+#include "navgraph.h"
 
 #include <cmath>
 #include <unordered_map>
 #include <iostream>
+#include <fstream>
+#include <iomanip>
 
 typedef EntityFactoryWrapper<Actor, ActorModel> ActorFactory;
 
@@ -31,10 +43,123 @@ GameManager &GameManager::getInstance()
   return instance;
 }
 
-GameManager::GameManager() : entityFactories(), canvas(Canvas::getInstance()), physics(PhysicsManager::getInstance()), debugHUD()
+GameManager::GameManager() :
+  entityFactories(), canvas(Canvas::getInstance()), physics(PhysicsManager::getInstance()), debugHUD(), sceneName(),
+  timeEntities(Stats::getInstance().add("time.entities", Stats::TIMER)),
+  timeAnimations(Stats::getInstance().add("time.animations", Stats::TIMER)),
+  timePhysics(Stats::getInstance().add("time.physics", Stats::TIMER)),
+  timeHitBoxes(Stats::getInstance().add("time.hitboxes", Stats::TIMER)),
+  timeChunks(Stats::getInstance().add("time.chunks", Stats::TIMER))
 {
   // Only 1 player right now
   entityFactories[TYPE_ACTOR] = new ActorFactory("actor", 0, true);
+  setupDebugHUD();
+}
+
+void GameManager::setupDebugHUD()
+{
+  Stats &stats = Stats::getInstance();
+  auto str = [](int id) { return StringUtil::toString(Stats::getInstance().getInt(id)); };
+  auto ms = [](int id) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2) << Stats::getInstance().get(id);
+    return out.str(); };
+
+  int fps = stats.addGauge("fps", [] { return Clock::getInstance().getFPS(); });
+  debugHUD.setLine(0, [=] { return "FPS: " + str(fps); });
+
+  SoundManager &soundmgr = SoundManager::getInstance();
+  int voices = stats.addGauge("sound.voices", [&soundmgr] { return soundmgr.getActiveVoiceCount(); }),
+    voiceCount = stats.addGauge("sound.voiceCount", [&soundmgr] { return soundmgr.getVoiceCount(); }),
+    culled = stats.addGauge("sound.culled", [&soundmgr] { return soundmgr.getCulledCount(); }),
+    stolen = stats.addGauge("sound.stolen", [&soundmgr] { return soundmgr.getStolenCount(); });
+  debugHUD.setLine(1, [=] { return "Voices: " + str(voices) + " / " + str(voiceCount)
+	+ " (culled " + str(culled) + ", stolen " + str(stolen) + ")"; });
+
+  EntityFactory *actors = entityFactories[TYPE_ACTOR];
+  int actorsActive = stats.addGauge("actors.active", [actors] { return actors->getActiveCount(); }),
+    actorsFree = stats.addGauge("actors.free", [actors] { return actors->getFreeCount(); });
+  debugHUD.setLine(2, [=] { return "Actor Pool: " + str(actorsActive) + " / " + str(actorsFree); });
+
+  int intersections = stats.add("physics.intersections", Stats::GAUGE);
+  debugHUD.setLine(3, [=] { return "Entity Intersections: " + str(intersections); });
+
+  int hitBoxesActive = stats.add("hitboxes.active", Stats::GAUGE),
+    hitBoxesFree = stats.add("hitboxes.free", Stats::GAUGE);
+  debugHUD.setLine(4, [=] { return "HitBox Pool: " + str(hitBoxesActive) + " / " + str(hitBoxesFree); });
+
+  int chunks = stats.addGauge("chunks.active", [] { return ChunkManager::getInstance().getActiveCount(); }),
+    chunkCapacity = stats.addGauge("chunks.capacity", [] { return ChunkManager::getInstance().getCapacity(); });
+  debugHUD.setLine(5, [=] { return "Chunk Pool: " + str(chunks) + " / " + str(chunkCapacity); });
+
+  // Directions never change
+  int offset = 6;
+  for (const std::string &line : GameConfig::getInstance().get().directions)
+    debugHUD.setMessage(offset++, line);
+
+  int god = stats.add("player.god", Stats::GAUGE);
+  debugHUD.setLine(10, [=] {
+      return "G: toggle god mode (it's " + std::string(Stats::getInstance().getInt(god) ? "ON" : "OFF") + ")"; });
+
+  int loaded = stats.addGauge("sound.loaded", [&soundmgr] { return soundmgr.getLoadedCount(); }),
+    sounds = stats.addGauge("sound.sounds", [&soundmgr] { return soundmgr.getSoundCount(); }),
+    cache = stats.addGauge("sound.cacheKB", [&soundmgr] { return soundmgr.getCacheSize()/1024; }),
+    budget = stats.addGauge("sound.budgetKB", [&soundmgr] { return soundmgr.getCacheBudget()/1024; }),
+    startup = stats.addGauge("sound.startupMs", [&soundmgr] { return soundmgr.getStartupTime(); }),
+    ready = stats.addGauge("sound.readyMs", [&soundmgr] { return soundmgr.getReadyTime(); });
+  debugHUD.setLine(12, [=] { return "Sound Cache: " + str(loaded) + " / " + str(sounds) + " sounds, "
+	+ str(cache) + " / " + str(budget) + " KB (startup " + str(startup) + "ms, ready " + str(ready) + "ms)"; });
+
+  PerceptionScheduler &perception = PerceptionScheduler::getInstance();
+  int checks = stats.addGauge("perception.checks", [&perception] { return perception.getChecks(); }),
+    deferred = stats.addGauge("perception.deferred", [&perception] { return perception.getDeferred(); }),
+    sightCast = stats.addGauge("perception.sightCast", [&perception] { return perception.getSightCast(); }),
+    sightReused = stats.addGauge("perception.sightReused", [&perception] { return perception.getSightReused(); });
+  debugHUD.setLine(13, [=] { return "Perception Checks: " + str(checks) + " (deferred " + str(deferred)
+	+ ", sight " + str(sightCast) + " cast / " + str(sightReused) + " reused)"; });
+
+  NavGraph &nav = NavGraph::getInstance();
+  int navNodes = stats.addGauge("nav.nodes", [&nav] { return nav.getNodeCount(); }),
+    navLinks = stats.addGauge("nav.links", [&nav] { return nav.getLinkCount(); }),
+    flowFields = stats.addGauge("nav.flowFields", [&nav] { return nav.getFlowFieldCount(); }),
+    flowRebuilds = stats.addGauge("nav.flowRebuilds", [&nav] { return nav.getFlowRebuilds(); });
+  debugHUD.setLine(14, [=] { return "Navigation: " + str(navNodes) + " nodes, " + str(navLinks) + " links, "
+	+ str(flowFields) + " flow fields (" + str(flowRebuilds) + " rebuilds)"; });
+
+  int animations = stats.addGauge("animations.active", [] { return AnimationSystem::getInstance().getActiveCount(); });
+  debugHUD.setLine(15, [=] { return "Animations: " + str(animations); });
+
+  debugHUD.setLine(16, [=] { return "Update ms: entities " + ms(timeEntities) + ", anims " + ms(timeAnimations)
+	+ ", physics " + ms(timePhysics) + ", hits " + ms(timeHitBoxes) + ", chunks " + ms(timeChunks); });
+
+  SceneStreamer &streamer = SceneStreamer::getInstance();
+  int regionsLoaded = stats.addGauge("streaming.loaded", [&streamer] { return streamer.getLoadedCount(); }),
+    regions = stats.addGauge("streaming.regions", [&streamer] { return streamer.getRegionCount(); }),
+    regionsPending = stats.addGauge("streaming.pending", [&streamer] { return streamer.getPendingCount(); });
+  debugHUD.setLine(17, [=] { return "Streaming: " + str(regionsLoaded) + " / " + str(regions) + " regions ("
+	+ str(regionsPending) + " pending)"; });
+
+  int cells = stats.addGauge("physics.cells", [this] { return physics.getCellCount(); }),
+    cellSlots = stats.addGauge("physics.cellSlots", [this] { return physics.getCellCapacity(); }),
+    gridKB = stats.addGauge("physics.gridKB", [this] { return physics.getGridMemory()/1024; }),
+    bvhNodes = stats.addGauge("physics.bvhNodes", [this] { return physics.getBVHNodeCount(); });
+  debugHUD.setLine(18, [=] {
+      int slots = Stats::getInstance().getInt(cellSlots);
+      return "Physics Grid: " + str(cells) + " cells in " + str(cellSlots) + " slots ("
+	+ StringUtil::toString(slots > 0 ? Stats::getInstance().getInt(cells)*100/slots : 0) + "% full), "
+	+ str(gridKB) + " KB, BVH " + str(bvhNodes) + " nodes"; });
+
+  int asleep = stats.addGauge("actors.asleep", [] { return Actor::getSleepingCount(); });
+  debugHUD.setLine(19, [=] {
+      return "Actors: " + StringUtil::toString(Stats::getInstance().getInt(actorsActive) - Stats::getInstance().getInt(asleep))
+	+ " awake, " + str(asleep) + " asleep"; });
+}
+
+void GameManager::dumpStats(const std::string &file) const
+{
+  std::ofstream out(file);
+  if (!out.is_open()) throw std::string("Couldn't write stats to " + file);
+  Stats::getInstance().dump(out);
 }
 
 GameManager::~GameManager()
@@ -47,25 +172,40 @@ void GameManager::update(float delta)
   //
   // Update all entities
   //
-  std::for_each(entityFactories.begin(), entityFactories.end(), [delta](auto &it) {
-      it.second->updateActiveList(delta); });
-  physics.updateEntityList();
-  canvas.updateEntityList();
+  Stats::getInstance().endFrame();
+  PerceptionScheduler::getInstance().beginFrame();
+
+  // Regions around where the view is and where it's headed
+  const Viewport &view = Viewport::getInstance();
+  SceneStreamer::getInstance().update(view.getPosition(), view.getTarget());
+  {
+    Stats::Timer timer(timeEntities);
+    std::for_each(entityFactories.begin(), entityFactories.end(), [delta](auto &it) {
+	it.second->updateActiveList(delta); });
+  }
+  {
+    Stats::Timer timer(timeAnimations);
+    AnimationSystem::getInstance().update(delta);
+  }
+  {
+    Stats::Timer timer(timePhysics);
+    physics.updateEntityList();
+    canvas.updateEntityList();
+    physics.testEntityCollisions();
+  }
+  {
+    Stats::Timer timer(timeHitBoxes);
+    HitBoxFactory::getInstance().updateActiveList(delta);
+  }
+  {
+    Stats::Timer timer(timeChunks);
+    ChunkManager::getInstance().update(delta);
+  }
 
-  physics.testEntityCollisions();
-  HitBoxFactory::getInstance().updateActiveList(delta);
-  
   //
   // Update debug info
   //
-  debugHUD.setMessage(0, "FPS: " + StringUtil::toString(static_cast<int>(Clock::getInstance().getFPS()+0.5f)));
-  debugHUD.setMessage(2, "Actor Pool: " + StringUtil::toString(entityFactories[TYPE_ACTOR]->getActiveCount()) + " / "
-		      + StringUtil::toString(entityFactories[TYPE_ACTOR]->getFreeCount()));
-
-  GameConfig &cfg = GameConfig::getInstance();
-  int offset = 6;
-  std::for_each(cfg["directions"].getChildren().begin(), cfg["directions"].getChildren().end(), [this, &offset](const XMLTag *t) {
-      debugHUD.setMessage(offset++, t->toStr()); });
+  debugHUD.update(delta);
 
   //debugHUD.setMessage(2, "backdrop pool: " + StringUtil::toString(backdropFactory.getActiveCount()) + "/" +
   //		      StringUtil::toString(backdropFactory.getFreeCount()));
@@ -87,16 +227,24 @@ void GameManager::draw() const
 
 void GameManager::clearScene()
 {
+  SceneStreamer::getInstance().close();
   physics.clearWorld();
+  NavGraph::getInstance().clear();
   canvas.clear();
   despawnAllEntities();
+  ChunkManager::getInstance().clear();
   EventManager::getInstance().clear();
+  sceneName.clear();
 }
 
 void GameManager::loadScene(const std::string &name)
 {
   clearScene();
+  // Start decoding the scene's sounds while everything else loads
+  SoundManager::getInstance().preloadManifest(name);
+
   XMLParser parser("assets/scenes/" + name + ".xml");
+  sceneName = name;
   const XMLTag &scene = parser.getTag("scene");
   EventManager &eventmgr = EventManager::getInstance();
 
@@ -128,6 +276,7 @@ void GameManager::loadScene(const std::string &name)
     physics.addWorldSegment( Vec2f(s["ax"].toFloat(), s["ay"].toFloat()),
 			     Vec2f(s["bx"].toFloat(), s["by"].toFloat()) );
   }
+  NavGraph::getInstance().build(name);
 
   // Load the objects
   const XMLTag &c = scene["canvas"];
@@ -161,6 +310,20 @@ void GameManager::loadScene(const std::string &name)
   }
 }
 
+void GameManager::streamScene(const std::string &name)
+{
+  clearScene();
+  SoundManager::getInstance().preloadManifest(name);
+  sceneName = name;
+  SceneStreamer::getInstance().open(name);
+}
+
+int GameManager::getEnemiesLeft() const
+{
+  SceneStreamer &streamer = SceneStreamer::getInstance();
+  return streamer.isOpen() ? streamer.getEnemiesLeft() : Actor::getMaskCounts(PhysicsManager::MASK_ENEMY);
+}
+
 Actor *GameManager::spawnActor(const std::string& model, int mask, const Vec2f &pos, Animation::Direction dir)
 {
   Actor *p = static_cast<Actor*>(spawnEntity( TYPE_ACTOR, model, mask, Canvas::LAYER_MAIN, pos, 0.f, Vec2f(0,0) ));
@@ -171,6 +334,7 @@ Actor *GameManager::spawnActor(const std::string& model, int mask, const Vec2f &
 Actor *GameManager::spawnPlayer(const std::string &model, const std::string &entry)
 {
   const EntryPoint &e = EventManager::getInstance().getEntryPoint(entry);
+  SceneStreamer::getInstance().loadAround(e.getPosition());
   return spawnActor(model, PhysicsManager::MASK_PLAYER, e.getPosition(), e.getDirection());
 }
 
@@ -204,6 +368,103 @@ void GameManager::spawnAllEnemies()
   }
 }
 
+void GameManager::capture(GameSnapshot &snap) const
+{
+  EntityFactory &actors = *entityFactories.at(TYPE_ACTOR);
+  snap.scene = sceneName;
+  snap.seed = Random::getInstance().getSeed();
+  snap.randomState = Random::getInstance().getState();
+
+  // Dead actors are on their way out (and have already exploded)
+  EntityIDs ids;
+  for (Entity *e : actors.getActiveList()) if (e->isAlive()) ids.add(e);
+
+  snap.actors.clear();
+  for (const Entity *e : actors.getActiveList()) {
+    if (!e->isAlive()) continue;
+    snap.actors.emplace_back();
+    static_cast<const Actor*>(e)->save(snap.actors.back(), ids);
+    snap.actors.back().model = actors.getModelName(e->getModel());
+  }
+
+  snap.hitBoxes.clear();
+  for (const HitBox *hb : HitBoxFactory::getInstance().getActiveList()) {
+    if (!hb->alive()) continue;
+    snap.hitBoxes.emplace_back();
+    HitBox::Snapshot &s = snap.hitBoxes.back();
+    hb->save(s, ids);
+
+    // The owner might be gone, so look through the models for the attack
+    for (auto &it : actors.getModels()) {
+      if ((s.attack = static_cast<const ActorModel*>(it.second)->getAttackID(hb->getModel())) >= 0) {
+	s.ownerModel = it.first;
+	break;
+      }
+    }
+    if (s.attack < 0) snap.hitBoxes.pop_back();
+  }
+
+  LightManager::getInstance().save(snap.lights);
+  SceneStreamer::getInstance().saveSpawns(snap.spawns, ids);
+}
+
+Actor *GameManager::restore(const GameSnapshot &snap, PlayerController *player)
+{
+  SceneStreamer &streamer = SceneStreamer::getInstance();
+  if (snap.scene != sceneName) streamScene(snap.scene);
+
+  // Clear out the old actors, and drop them from the lists now so the same
+  // ones can be registered again right away
+  despawnAllEntities();
+  physics.updateEntityList();
+  canvas.updateEntityList();
+  HitBoxFactory::getInstance().clear();
+  ChunkManager::getInstance().clear();
+
+  // The ground has to be there before anyone stands on it
+  for (const Actor::Snapshot &s : snap.actors)
+    if (s.control == Actor::CONTROL_PLAYER) streamer.loadAround(s.position);
+
+  // Spawning puts each one at the front, so go backwards to get the same order
+  std::vector<Actor*> spawned(snap.actors.size());
+  for (int i = snap.actors.size()-1; i >= 0; i--) {
+    const Actor::Snapshot &s = snap.actors[i];
+    spawned[i] = spawnActor(s.model, s.mask, s.position, static_cast<Animation::Direction>(s.anim.direction));
+  }
+
+  EntityIDs ids;
+  for (Actor *a : spawned) ids.add(a);
+  if (streamer.isOpen()) streamer.restoreSpawns(snap.spawns, ids);
+
+  Actor *playerActor = nullptr;
+  for (unsigned i = 0; i < spawned.size(); i++) {
+    spawned[i]->restore(snap.actors[i], ids);
+    if (snap.actors[i].control == Actor::CONTROL_PLAYER && player != nullptr)
+      (playerActor = spawned[i])->setPlayerControlled(player);
+  }
+
+  // Animations update in slot order, which decides who plays their sounds
+  // (and draws random numbers for them) first
+  std::vector<unsigned> bySlot(spawned.size());
+  for (unsigned i = 0; i < bySlot.size(); i++) bySlot[i] = i;
+  std::sort(bySlot.begin(), bySlot.end(), [&snap](unsigned a, unsigned b) {
+      return snap.actors[a].anim.slot < snap.actors[b].anim.slot; });
+  for (unsigned i : bySlot) spawned[i]->getAnimationState().moveToSlot(snap.actors[i].anim.slot);
+
+  HitBoxFactory &hitBoxes = HitBoxFactory::getInstance();
+  for (int i = snap.hitBoxes.size()-1; i >= 0; i--) {
+    const HitBox::Snapshot &s = snap.hitBoxes[i];
+    const ActorModel *model = static_cast<const ActorModel*>(entityFactories[TYPE_ACTOR]->getModel(s.ownerModel));
+    if (s.attack < 0 || s.attack >= model->getAttackCount())
+      throw std::string("Model " + s.ownerModel + " doesn't have attack " + StringUtil::toString(s.attack));
+    hitBoxes.restoreHitBox(s, &model->getAttack(s.attack).hitBox, ids);
+  }
+
+  // Last, since spawning and taking control draw random numbers
+  Random::getInstance().restore(snap.seed, snap.randomState);
+  return playerActor;
+}
+
 void GameManager::despawnAllEntities()
 {
   std::for_each(entityFactories.begin(), entityFactories.end(), [](auto &it) {
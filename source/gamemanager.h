@@ -16,6 +16,8 @@ class EntityFactory;
 class Actor;
 class Canvas;
 class PhysicsManager;
+class PlayerController;
+struct GameSnapshot;
 
 class GameManager
 {
@@ -33,10 +35,21 @@ class GameManager
 
   void clearScene();
   void loadScene(const std::string&);
+
+  // Loads the scene a region at a time around the view (see SceneStreamer),
+  // spawning enemies as their regions come in. loadScene() still loads the
+  // whole thing, for the editor.
+  void streamScene(const std::string&);
+
+  // Enemies still to be killed, including ones that haven't been streamed in yet
+  int getEnemiesLeft() const;
   void toggleDebugHUD() { debugHUD.toggle(); }
 
   void setDebugMessage(int lineID, const std::string& msg) { debugHUD.setMessage(lineID, msg); }
 
+  // Writes every stat to a JSON file
+  void dumpStats(const std::string &file) const;
+
   Actor *spawnPlayer(const std::string &model, const std::string &entry);
   Actor *spawnEnemy(const std::string &model, const Vec2f &pos, Animation::Direction);
   Actor *spawnActor(const std::string &model, int mask, const Vec2f &pos, Animation::Direction);
@@ -47,6 +60,16 @@ class GameManager
 
   void despawnAllEntities();
 
+  const std::string &getSceneName() const { return sceneName; }
+
+  // Copies everything that changes in the scene into the snapshot
+  void capture(GameSnapshot&) const;
+
+  // Puts the scene back the way it was in the snapshot, loading the scene
+  // only if it's a different one. The actor the player was controlling gets
+  // the given controller, and is returned (nullptr if there wasn't one).
+  Actor *restore(const GameSnapshot&, PlayerController*);
+
   GameManager(const GameManager&) = delete;
   GameManager &operator=(const GameManager&) = delete;
 
@@ -58,6 +81,11 @@ class GameManager
   PhysicsManager &physics;
 
   DebugHUD debugHUD;
+  std::string sceneName;
+
+  // Timers for each part of update
+  int timeEntities, timeAnimations, timePhysics, timeHitBoxes, timeChunks;
+  void setupDebugHUD();
 
   Entity *spawnEntity( ObjectType t, const std::string &model, int mask, int layer, const Vec2f &position, float angle, const Vec2f &scale );
 };
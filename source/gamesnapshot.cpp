@@ -0,0 +1,223 @@
+#include "gamesnapshot.h"
+#include "binaryio.h"
+
+namespace {
+
+// "SAV1" files never had a version, and changed under the same magic
+const char MAGIC[] = "SAV2";
+
+void write(BinaryWriter &out, const Actor::Snapshot &a)
+{
+  out.putString(a.model);
+  out.put(a.mask, 4);
+  out.putVec(a.position);
+  out.putVec(a.offset);
+  out.put(a.control, 1);
+  out.putFloat(a.attributes.health);
+  out.put(a.attributes.super, 1);
+  out.put(a.currentAnim, 1);
+  out.put(a.actionState, 1);
+  out.putFloat(a.pauseTimer);
+  out.put(a.attackId, 4);
+  out.put(a.attackMask, 4);
+  out.put(a.god, 1);
+  out.put(a.asleep, 1);
+  out.putFloat(a.lodTime);
+
+  const AnimationState::Snapshot &an = a.anim;
+  out.put(an.anim, 4);
+  out.put(an.direction, 1);
+  out.putFloat(an.playSpeed);
+  out.putFloat(an.time);
+  out.putFloat(an.soundTimer);
+  out.put(an.frame, 4);
+  out.put(an.lastSound, 4);
+  out.put(an.paused, 1);
+  out.put(an.slot, 4);
+
+  const ActorPhysics::Snapshot &p = a.physics;
+  out.put(p.state, 1);
+  out.put(p.visibleState, 1);
+  out.put(p.ledgeState, 1);
+  out.put(p.wallState, 1);
+  out.putVec(p.velocity);
+  out.putFloat(p.disabledTime);
+  out.putFloat(p.spriteOffsetVelocity);
+  out.put(p.spriteFakeState, 1);
+  out.putFloat(p.movement);
+  out.putVec(p.groundC);
+  out.putVec(p.groundD);
+  out.putVec(p.groundRight);
+  out.put(p.groundLedge, 1);
+  out.put(p.groundSegment, 4);
+
+  const AIController::Snapshot &ai = a.ai;
+  out.put(ai.state, 1);
+  out.putFloat(ai.stateTimer);
+  out.putVec(ai.originPos);
+  out.put(ai.target, 4);
+  out.putFloat(ai.perceptionTimer);
+  out.put(ai.sightTarget, 4);
+  out.putVec(ai.sightFrom);
+  out.putVec(ai.sightTo);
+  out.putFloat(ai.sightAge);
+  out.put(ai.sightVisible, 1);
+  out.put(ai.targetNode, 4);
+  out.put(ai.navLink, 4);
+  out.put(ai.navJump, 1);
+}
+
+void read(BinaryReader &in, Actor::Snapshot &a)
+{
+  a.model = in.getString();
+  a.mask = in.getInt(4);
+  a.position = in.getVec();
+  a.offset = in.getVec();
+  a.control = in.get(1);
+  a.attributes.health = in.getFloat();
+  a.attributes.super = in.get(1);
+  a.currentAnim = in.get(1);
+  a.actionState = in.get(1);
+  a.pauseTimer = in.getFloat();
+  a.attackId = in.getInt(4);
+  a.attackMask = in.getInt(4);
+  a.god = in.get(1);
+  a.asleep = in.get(1);
+  a.lodTime = in.getFloat();
+
+  AnimationState::Snapshot &an = a.anim;
+  an.anim = in.getInt(4);
+  an.direction = in.get(1);
+  an.playSpeed = in.getFloat();
+  an.time = in.getFloat();
+  an.soundTimer = in.getFloat();
+  an.frame = in.getInt(4);
+  an.lastSound = in.getInt(4);
+  an.paused = in.get(1);
+  an.slot = in.getInt(4);
+
+  ActorPhysics::Snapshot &p = a.physics;
+  p.state = in.get(1);
+  p.visibleState = in.get(1);
+  p.ledgeState = in.get(1);
+  p.wallState = in.get(1);
+  p.velocity = in.getVec();
+  p.disabledTime = in.getFloat();
+  p.spriteOffsetVelocity = in.getFloat();
+  p.spriteFakeState = in.get(1);
+  p.movement = in.getFloat();
+  p.groundC = in.getVec();
+  p.groundD = in.getVec();
+  p.groundRight = in.getVec();
+  p.groundLedge = in.get(1);
+  p.groundSegment = in.getInt(4);
+
+  AIController::Snapshot &ai = a.ai;
+  ai.state = in.get(1);
+  ai.stateTimer = in.getFloat();
+  ai.originPos = in.getVec();
+  ai.target = in.getInt(4);
+  ai.perceptionTimer = in.getFloat();
+  ai.sightTarget = in.getInt(4);
+  ai.sightFrom = in.getVec();
+  ai.sightTo = in.getVec();
+  ai.sightAge = in.getFloat();
+  ai.sightVisible = in.get(1);
+  ai.targetNode = in.getInt(4);
+  ai.navLink = in.getInt(4);
+  ai.navJump = in.get(1);
+}
+
+void write(BinaryWriter &out, const HitBox::Snapshot &h)
+{
+  out.putString(h.ownerModel);
+  out.put(h.attack, 4);
+  out.put(h.owner, 4);
+  out.put(h.mask, 4);
+  out.putFloat(h.life);
+  out.putVec(h.position);
+  out.put(h.direction, 1);
+  out.put(h.hitList.size(), 2);
+  for (int id : h.hitList) out.put(id, 4);
+  out.put(h.soundQueue, 4);
+  out.putFloat(h.soundTimer);
+}
+
+void read(BinaryReader &in, HitBox::Snapshot &h)
+{
+  h.ownerModel = in.getString();
+  h.attack = in.getInt(4);
+  h.owner = in.getInt(4);
+  h.mask = in.getInt(4);
+  h.life = in.getFloat();
+  h.position = in.getVec();
+  h.direction = in.get(1);
+  h.hitList.resize(in.get(2));
+  for (int &id : h.hitList) id = in.getInt(4);
+  h.soundQueue = in.getInt(4);
+  h.soundTimer = in.getFloat();
+}
+
+}
+
+GameSnapshot::GameSnapshot() :
+  scene(), seed(0), randomState(0), actors(), hitBoxes(), lights(), spawns(),
+  playState(0), endPicture(0.f), light(-1) {}
+
+void GameSnapshot::save(const std::string &file) const
+{
+  BinaryWriter out(file, MAGIC);
+  out.put(VERSION, 2);
+  out.putString(scene);
+  out.put(seed, 8);
+  out.put(randomState, 8);
+
+  out.put(actors.size(), 4);
+  for (const Actor::Snapshot &a : actors) write(out, a);
+  out.put(hitBoxes.size(), 4);
+  for (const HitBox::Snapshot &h : hitBoxes) write(out, h);
+
+  out.putFloat(lights.ambience);
+  out.put(lights.lights.size(), 4);
+  for (const LightManager::Snapshot::LightData &l : lights.lights) {
+    out.putVec(l.position);
+    out.putFloat(l.size);
+    out.putFloat(l.intensity);
+  }
+
+  out.put(spawns.size(), 4);
+  for (int s : spawns) out.put(s, 4);
+
+  out.put(playState, 1);
+  out.putFloat(endPicture);
+  out.put(light, 4);
+}
+
+void GameSnapshot::load(const std::string &file)
+{
+  BinaryReader in(file, MAGIC);
+  if (in.get(2) != VERSION) throw std::string("Save file " + file + " is from another version");
+  scene = in.getString();
+  seed = in.get(8);
+  randomState = in.get(8);
+
+  actors.resize(in.get(4));
+  for (Actor::Snapshot &a : actors) read(in, a);
+  hitBoxes.resize(in.get(4));
+  for (HitBox::Snapshot &h : hitBoxes) read(in, h);
+
+  lights.ambience = in.getFloat();
+  lights.lights.resize(in.get(4));
+  for (LightManager::Snapshot::LightData &l : lights.lights) {
+    l.position = in.getVec();
+    l.size = in.getFloat();
+    l.intensity = in.getFloat();
+  }
+
+  spawns.resize(in.get(4));
+  for (int &s : spawns) s = in.getInt(4);
+
+  playState = in.get(1);
+  endPicture = in.getFloat();
+  light = in.getInt(4);
+}
@@ -0,0 +1,74 @@
+#ifndef GAMESNAPSHOT_H
+#define GAMESNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "lightmanager.h"
+#include "entity/actor.h"
+#include "entity/hitbox.h"
+
+class Entity;
+
+/*
+ * Everything in a scene that changes while it's played: the actors (with
+ * their physics, animation and AI), hit boxes, lights and where the random
+ * numbers are at. The scene itself (collision, navigation, backdrops, spawns)
+ * never changes once it's loaded, so it's only kept by name. Capturing and
+ * restoring is copying these around, without touching the scene's files.
+ *
+ * Chunks from explosions aren't kept, they're just for show.
+ *
+ * Saved files are little-endian, starting with "SAV2" and a u16 VERSION. See
+ * save() for the rest. Anything that changes what gets written bumps VERSION,
+ * and saves from any other version are refused.
+ */
+struct GameSnapshot
+{
+  GameSnapshot();
+
+  std::string scene;
+  uint64_t seed, randomState;
+
+  // Newest first, like the factories keep them
+  std::vector<Actor::Snapshot> actors;
+  std::vector<HitBox::Snapshot> hitBoxes;
+  LightManager::Snapshot lights;
+
+  // For streamed scenes, what became of each enemy spawn (see SceneStreamer::saveSpawns)
+  std::vector<int> spawns;
+
+  // GameState's own things
+  int playState;
+  float endPicture;
+  int light; // Index into lights.lights, -1 if none
+
+  static const unsigned VERSION = 5;
+
+  void save(const std::string &file) const;
+  void load(const std::string &file);
+};
+
+// Entities point at each other (AI targets, hit box owners). Snapshots keep
+// those as an index into the snapshot's actors, and -1 for nobody.
+class EntityIDs
+{
+ public:
+  EntityIDs() : entities(), ids() {}
+
+  void add(Entity *e) { ids[e] = entities.size(); entities.push_back(e); }
+
+  int find(const Entity *e) const {
+    auto it = ids.find(e);
+    return it == ids.end() ? -1 : it->second; }
+
+  Entity *get(int id) const { return id >= 0 && id < static_cast<int>(entities.size()) ? entities[id] : nullptr; }
+
+ private:
+  std::vector<Entity*> entities;
+  std::unordered_map<const Entity*, int> ids;
+};
+
+#endif
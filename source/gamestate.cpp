@@ -8,14 +8,17 @@
 #include "image.h"
 #include "stringutil.h"
 #include "iomod.h"
+#include "stats.h"
 
 #include "entity/actor.h"
 #include "entity/actorphysics.h"
 
 #include <SDL.h>
+#include <iostream>
 
 const float DEATH_TIME = .333f;
 const float AMBIENCE = 0.5f;
+const char *SAVE_FILE = "save.sav";
 
 GameState::GameState() :
   gamemgr( GameManager::getInstance() ),
@@ -26,7 +29,9 @@ GameState::GameState() :
   light(nullptr),
   endPicture(0.f),
   picDeath(ImageFactory::getInstance().getImage("assets/youdied.png")),
-  picVictory(ImageFactory::getInstance().getImage("assets/victory.png"))
+  picVictory(ImageFactory::getInstance().getImage("assets/victory.png")),
+  statGod(Stats::getInstance().add("player.god", Stats::GAUGE)),
+  start()
 {
 }
 
@@ -37,9 +42,8 @@ GameState::~GameState()
 void GameState::enter()
 {
   // The previous state should load the scene
-  gamemgr.loadScene("scn_area1");
+  gamemgr.streamScene("scn_area1");
   spawnPlayer();
-  gamemgr.spawnAllEnemies();
 
   LightManager &lightmgr = LightManager::getInstance();
   light = lightmgr.addLight( playerActor->getPosition(), 2000, 1.f );
@@ -47,6 +51,8 @@ void GameState::enter()
 
   state = STATE_PLAYING;
   endPicture = 0.f;
+
+  capture(start);
 }
 
 void GameState::exit()
@@ -71,10 +77,33 @@ void GameState::input(const SDL_Event& event)
     case SDL_SCANCODE_LCTRL: case SDL_SCANCODE_RCTRL: playerController.inputAttack(); break;
     case SDL_SCANCODE_DELETE: playerActor->destroy(); break;
     case SDL_SCANCODE_F1:    gamemgr.toggleDebugHUD(); break;
+    case SDL_SCANCODE_F3:
+      try { gamemgr.dumpStats("stats.json"); }
+      catch (const std::string &msg) { std::cout << msg << std::endl; }
+      break;
     case SDL_SCANCODE_G:     playerActor->setGod(!playerActor->isAGod()); break;
 
     // Restart the game
-    case SDL_SCANCODE_F2: exit(); enter(); break;
+    case SDL_SCANCODE_F2: restore(start); break;
+
+    case SDL_SCANCODE_F5:
+      try {
+	GameSnapshot snap;
+	capture(snap);
+	snap.save(SAVE_FILE);
+	std::cout << "Saved to " << SAVE_FILE << std::endl;
+      }
+      catch (const std::string &msg) { std::cout << msg << std::endl; }
+      break;
+
+    case SDL_SCANCODE_F9:
+      try {
+	GameSnapshot snap;
+	snap.load(SAVE_FILE);
+	restore(snap);
+      }
+      catch (const std::string &msg) { std::cout << msg << std::endl; }
+      break;
       
     default: break;
     }
@@ -91,7 +120,7 @@ void GameState::input(const SDL_Event& event)
 
 void GameState::update(float delta)
 {
-  if (Actor::getMaskCounts(PhysicsManager::MASK_ENEMY) == 0)
+  if (gamemgr.getEnemiesLeft() == 0)
     state = STATE_VICTORY;
   
   if (state == STATE_DEAD)
@@ -99,10 +128,7 @@ void GameState::update(float delta)
   else
     gamemgr.update(delta);
 
-  if (playerActor != nullptr)
-    gamemgr.setDebugMessage(10, "G: toggle god mode (it's " + (playerActor->isAGod() ? std::string("ON"):std::string("OFF")) + ")");
-  else
-    gamemgr.setDebugMessage(10, "G: toggle god mode (it's OFF)");
+  Stats::getInstance().set(statGod, playerActor != nullptr && playerActor->isAGod());
   
   if (state == STATE_PLAYING) {
     Viewport::getInstance().setTarget( playerActor->getPosition() - playerActor->getOffset()
@@ -135,7 +161,7 @@ void GameState::draw() const
     picVictory->superDraw(0, 0, 1.f, endPicture);
   }
 
-  IoMod::getInstance().writeText("Enemies Left: " + StringUtil::toString(Actor::getMaskCounts(PhysicsManager::MASK_ENEMY)),
+  IoMod::getInstance().writeText("Enemies Left: " + StringUtil::toString(gamemgr.getEnemiesLeft()),
 				 30, Viewport::getInstance().getHeight() - 120);
 
   if (state != STATE_PLAYING) return;
@@ -164,6 +190,31 @@ void GameState::draw() const
   }
 }
 
+void GameState::capture(GameSnapshot &snap) const
+{
+  gamemgr.capture(snap);
+  snap.playState = state;
+  snap.endPicture = endPicture;
+  snap.light = LightManager::getInstance().find(light);
+}
+
+void GameState::restore(const GameSnapshot &snap)
+{
+  playerActor = gamemgr.restore(snap, &playerController);
+
+  LightManager &lightmgr = LightManager::getInstance();
+  std::vector<Light*> lights = lightmgr.restore(snap.lights);
+  ambience = lightmgr.getAmbience();
+  if (snap.light >= 0 && snap.light < static_cast<int>(lights.size())) light = lights[snap.light];
+  else light = lightmgr.addLight( Vec2f(0, 0), 2000, 1.f );
+
+  state = static_cast<State>(snap.playState);
+  endPicture = snap.endPicture;
+
+  // Saved right as the player was being destroyed
+  if (state == STATE_PLAYING && playerActor == nullptr) state = STATE_DEAD;
+}
+
 void GameState::spawnPlayer()
 {
   (playerActor = gamemgr.spawnPlayer("player", "start"))->setPlayerControlled(&playerController);
@@ -2,6 +2,7 @@
 #define GAMESTATE_H
 
 #include "appstate.h"
+#include "gamesnapshot.h"
 #include "entity/playercontroller.h"
 
 class GameManager;
@@ -45,7 +46,14 @@ class GameState : public AppState
   const Image *picDeath;
   const Image *picVictory;
 
+  int statGod;
+
+  // The scene right after it started, to restart from without loading it
+  GameSnapshot start;
+
   void spawnPlayer();
+  void capture(GameSnapshot&) const;
+  void restore(const GameSnapshot&);
 };
 
 #endif
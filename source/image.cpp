@@ -1,4 +1,5 @@
 #include <SDL.h>
+#include <algorithm>
 
 #include "image.h"
 #include "viewport.h"
@@ -10,7 +11,53 @@ Image::Image( const std::string &n, SDL_Surface* surf, SDL_Texture *tex) :
   surface( surf ),
   texture( tex ),
   frames(),
-  shapes() {}
+  shapeVertices(),
+  hullVertices(),
+  hullNormals() {}
+
+void Image::buildHulls()
+{
+  hullVertices.clear();
+  hullNormals.clear();
+
+  for (Frame &f : frames) {
+    f.firstHull = hullVertices.size();
+    f.hullCount = 0;
+    if (f.vertexCount < 3) continue;
+
+    // Monotone chain
+    std::vector<Vec2f> pts(shapeVertices.begin() + f.firstVertex, shapeVertices.begin() + f.firstVertex + f.vertexCount);
+    std::sort(pts.begin(), pts.end(), [](const Vec2f &a, const Vec2f &b) {
+	return a[0] < b[0] || (a[0] == b[0] && a[1] < b[1]); });
+
+    std::vector<Vec2f> hull(pts.size()*2);
+    size_t k = 0;
+    for (size_t i = 0; i < pts.size(); i++) {
+      while (k >= 2 && (hull[k-1]-hull[k-2]).cross(pts[i]-hull[k-2]) <= 0.f) k--;
+      hull[k++] = pts[i];
+    }
+    for (size_t i = pts.size()-1, lower = k+1; i > 0; i--) {
+      while (k >= lower && (hull[k-1]-hull[k-2]).cross(pts[i-1]-hull[k-2]) <= 0.f) k--;
+      hull[k++] = pts[i-1];
+    }
+    hull.resize(k > 0 ? k-1 : 0);
+    if (hull.size() < 3) continue;
+
+    Vec2f center(0,0);
+    for (const Vec2f &v : hull) center += v;
+    center = center / hull.size();
+
+    // Edge i goes from vertex i to i+1. Flip normals that point inwards.
+    for (size_t i = 0; i < hull.size(); i++) {
+      Vec2f edge = hull[(i+1)%hull.size()] - hull[i];
+      Vec2f normal = Vec2f(-edge[1], edge[0]).normalize();
+      if (normal.dot(hull[i] - center) < 0.f) normal = -normal;
+      hullVertices.push_back(hull[i]);
+      hullNormals.push_back(normal);
+    }
+    f.hullCount = hull.size();
+  }
+}
 
 void Image::draw(int dx, int dy, float scrollFactor, float sx, float sy) const
 {
@@ -76,39 +123,37 @@ void Image::draw(int dx, int dy, unsigned frame, float scrollFactor,
   //SDL_RenderCopyEx(renderer, texture, &src, &dest, 0.f, &center, SDL_FLIP_NONE);
 }
 
-void Image::drawChunk(int dx, int dy, unsigned frame, float sx, float sy, float sw, float sh, float alpha, float scrollFactor) const
+void Image::drawChunks(unsigned frame, float size, int count, const float *x, const float *y,
+			const float *sx, const float *sy, const float *alpha, float scrollFactor) const
 {
   const Viewport &v = Viewport::getInstance();
   float zoom = v.getZoomFactor();
 
-  float viewx = v.getX(),
-    viewy = v.getY();
-
-  dx -= viewx * scrollFactor;
-  dy -= viewy * scrollFactor;
-  
-  dx *= zoom;
-  dy *= zoom;
-
-  dx += v.getWidth()/2;
-  dy += v.getHeight()/2;
+  float viewx = v.getX() * scrollFactor,
+    viewy = v.getY() * scrollFactor;
+  int hw = v.getWidth()/2,
+    hh = v.getHeight()/2;
 
   const Frame &f = frames.at(frame);
-  
-  SDL_Rect src = { (int)(f.x+sx*f.w),
-		   (int)(f.y+sy*f.h),
-		   (int)(f.w*sw),
-		   (int)(f.h*sh) };
-  
-  SDL_Point center = { -static_cast<int>(f.ox * zoom + 0.5),
-		       -static_cast<int>(f.oy * zoom + 0.5) };
-  SDL_Rect dest  = { dx - center.x + (int)(sx*f.w), dy - center.y + (int)(sy*f.h),
-		     static_cast<int>(f.w * sw * zoom + 0.5),
-		     static_cast<int>(f.h * sh * zoom + 0.5) };
-  
-  SDL_SetTextureAlphaMod(texture, alpha*255);
-  SDL_RenderCopyEx(renderer, texture, &src, &dest, 0, &center,
-		   SDL_FLIP_NONE );
+
+  int cx = static_cast<int>(f.ox * zoom + 0.5),
+    cy = static_cast<int>(f.oy * zoom + 0.5);
+  int w = static_cast<int>(f.w * size * zoom + 0.5),
+    h = static_cast<int>(f.h * size * zoom + 0.5);
+
+  // Only touch the texture's alpha when it actually changes
+  int lastAlpha = -1;
+  for (int i = 0; i < count; i++) {
+    int a = static_cast<int>(std::max(alpha[i], 0.f) * 255);
+    if (a != lastAlpha) SDL_SetTextureAlphaMod(texture, lastAlpha = a);
+
+    int ox = sx[i]*f.w, oy = sy[i]*f.h;
+    SDL_Rect src = { f.x + ox, f.y + oy, static_cast<int>(f.w*size), static_cast<int>(f.h*size) };
+    SDL_Rect dest = { static_cast<int>((static_cast<int>(x[i]) - viewx) * zoom) + hw + cx + ox,
+		      static_cast<int>((static_cast<int>(y[i]) - viewy) * zoom) + hh + cy + oy,
+		      w, h };
+    SDL_RenderCopy(renderer, texture, &src, &dest);
+  }
 }
 
 void Image::superDraw(int dx, int dy, float scale, float alpha) const
@@ -24,7 +24,10 @@ public:
 	    float scaleX = 1.f, float scaleY = 1.f,
 	    bool flipH = false, bool flipV = false) const;
 
-  void drawChunk(int dx, int dy, unsigned frame, float sx, float sy, float sw, float sh, float alpha, float scrollFactor) const;
+  // Draws many square sections of one frame at once (see ChunkManager). Each
+  // section i is cut from (sx[i], sy[i]) of the frame, ranging from 0 to 1.
+  void drawChunks(unsigned frame, float size, int count, const float *x, const float *y,
+		  const float *sx, const float *sy, const float *alpha, float scrollFactor) const;
 
   // Unaffected by viewport position/zoom
   void superDraw(int dx, int dy, float scale, float alpha) const;
@@ -44,20 +47,31 @@ public:
   int getFrameCenterX(int i) const { return frames[i].ox; }
   int getFrameCenterY(int i) const { return frames[i].oy; }
   
-  const std::vector<Vec2f> &getShapeVertices(unsigned frame) const { return frames.at(frame).vertices; }
+  // Collision shape outline of a frame
+  const Vec2f *getShapeVertices(unsigned frame) const { return shapeVertices.data() + frames.at(frame).firstVertex; }
+  unsigned getShapeVertexCount(unsigned frame) const { return frames.at(frame).vertexCount; }
+
+  // Convex hull of a frame's collision shape (relative to the frame's top
+  // left corner) with an outward normal per edge, worked out when the image
+  // loads. Size is 0 for frames without a shape.
+  unsigned getHullSize(unsigned frame) const { return frames[frame].hullCount; }
+  const Vec2f *getHullVertices(unsigned frame) const { return hullVertices.data() + frames[frame].firstHull; }
+  const Vec2f *getHullNormals(unsigned frame) const { return hullNormals.data() + frames[frame].firstHull; }
   const std::pair<Vec2f,Vec2f> &getShapeBounds(unsigned frame) const { return frames.at(frame).vbounds; }
 
   Image() = delete;
   Image(const Image&) = delete;
   Image& operator=(const Image&) = delete;
 
-  // The format of a '.frame' file
+  // A frame of a '.frame' file (see framefile.h)
   struct Frame
   {
-    Frame() : x(0), y(0), w(0), h(0), ox(0), oy(0), vertices(), vbounds(std::make_pair(Vec2f(0,0), Vec2f(0,0))) {}
+    Frame() : x(0), y(0), w(0), h(0), ox(0), oy(0), firstVertex(0), vertexCount(0), firstHull(0), hullCount(0),
+      vbounds(std::make_pair(Vec2f(0,0), Vec2f(0,0))) {}
     unsigned short x, y, w, h;
     short ox, oy;
-    std::vector<Vec2f> vertices;
+    unsigned firstVertex, vertexCount; // into shapeVertices
+    unsigned firstHull, hullCount; // into hullVertices and hullNormals
 
     // center + half dimensions
     std::pair<Vec2f, Vec2f> vbounds;
@@ -73,7 +87,11 @@ private:
   SDL_Texture *texture;
 
   std::vector<Frame> frames;
-  std::vector< std::vector<Vec2f> > shapes; // correspond to frames
+  std::vector<Vec2f> shapeVertices; // of every frame, one after another
+  std::vector<Vec2f> hullVertices, hullNormals;
+
+  // Fills in the hulls from the shape vertices (ImageFactory calls this after loading frames)
+  void buildHulls();
 };
 
 #endif
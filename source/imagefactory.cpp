@@ -52,7 +52,8 @@ Image* ImageFactory::getImage(const std::string& name)
     images[name] = image;
 
     // Try to find a frame file for the image
-    IoMod::getInstance().readFrameData(name, image->frames);
+    IoMod::getInstance().readFrameData(name, image->frames, image->shapeVertices);
+    image->buildHulls();
 
     return image;
   }
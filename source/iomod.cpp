@@ -3,9 +3,11 @@
 #include "iomod.h"
 #include "gameconfig.h"
 #include "rendercontext.h"
+#include "framefile.h"
 
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 #include <SDL_ttf.h>
 
 IoMod& IoMod::getInstance() {
@@ -22,8 +24,8 @@ IoMod::IoMod() :
   cfg(GameConfig::getInstance()),
   init(TTF_Init()),
   renderer( RenderContext::getInstance().getRenderer() ),
-  font(TTF_OpenFont(cfg["font"]["file"].toStr().c_str(),
-                    cfg["font"]["size"].toInt())),
+  font(TTF_OpenFont(cfg.get().font.file.c_str(),
+                    cfg.get().font.size)),
   textColor({0xff, 0, 0, 0})
 {
   if ( init == -1 ) {
@@ -32,10 +34,11 @@ IoMod::IoMod() :
   if (font == NULL) {
     throw std::string("error: font not found");
   }
-  textColor.r = cfg["font"]["red"].toInt();
-  textColor.g = cfg["font"]["green"].toInt();
-  textColor.b = cfg["font"]["blue"].toInt();
-  textColor.a = cfg["font"]["alpha"].toInt();
+  const Settings::Color &color = cfg.get().font.color;
+  textColor.r = color.r;
+  textColor.g = color.g;
+  textColor.b = color.b;
+  textColor.a = color.a;
 }
 
 SDL_Texture* IoMod::readTexture(const std::string& filename)
@@ -56,52 +59,50 @@ SDL_Surface* IoMod::readSurface(const std::string& filename)
   return surface;
 }
 
-void IoMod::readFrameData(const std::string &name, std::vector<Image::Frame> &data)
+void IoMod::readFrameData(const std::string &name, std::vector<Image::Frame> &data, std::vector<Vec2f> &vertices)
 {
-  std::ifstream fin(name.substr(0, name.length()-3) + "frame", std::ios::in | std::ios::binary);
-  if (fin.is_open()) {
-    unsigned short count;
-    fin.read((char*)&count, sizeof(unsigned short));
-    data.resize(count);
-    for (unsigned short i = 0; i < count; i++) {
-      fin.read((char*)&data[i], sizeof(unsigned short)*6);
-
-      // Read shape data
-      unsigned vertexCount;
-      fin.read((char*)&vertexCount, sizeof(unsigned));
-
-      if (vertexCount > 0) {
-	data[i].vertices.resize(vertexCount);
-	float left = 100000.f, right = 0.f, top = 100000.f, bottom = 0.f;
-	for (unsigned v = 0; v < vertexCount; v++) {
-	  float x, y;
-	  fin.read((char*)&x, sizeof(float));
-	  fin.read((char*)&y, sizeof(float));
-
-	  data[i].vertices[v][0] = x;
-	  data[i].vertices[v][1] = y;
-
-	  data[i].vbounds.first += data[i].vertices[v];
-
-	  left   = std::min(left, x);
-	  right  = std::max(right, x);
-	  top    = std::min(top, y);
-	  bottom = std::max(bottom, y);
-	}
-	data[i].vbounds.first = data[i].vbounds.first / vertexCount;
-	data[i].vbounds.second = Vec2f(right-left, bottom-top) * .5f;
+  std::string file = name.substr(0, name.length()-3) + "frame";
+  std::ifstream fin(file, std::ios::in | std::ios::binary | std::ios::ate);
+  if (!fin.is_open()) return;
+
+  // Read the whole thing at once
+  std::vector<unsigned char> bytes(static_cast<size_t>(fin.tellg()));
+  fin.seekg(0);
+  if (!fin.read(reinterpret_cast<char*>(bytes.data()), bytes.size()))
+    throw std::string("Couldn't read ") + file;
+
+  FrameFile frameFile;
+  frameFile.decode(bytes.data(), bytes.size(), file);
+  if (!FrameFile::isVersion2(bytes.data(), bytes.size()))
+    std::cout << "  " << file << " is in the old frame format. Run frameconvert on it." << std::endl;
+
+  vertices.resize(frameFile.vertices.size()/2);
+  for (size_t v = 0; v < vertices.size(); v++)
+    vertices[v] = Vec2f(frameFile.vertices[v*2], frameFile.vertices[v*2+1]);
+
+  data.resize(frameFile.frames.size());
+  for (size_t i = 0; i < data.size(); i++) {
+    const FrameRecord &r = frameFile.frames[i];
+    Image::Frame &f = data[i];
+    f.x = r.x; f.y = r.y; f.w = r.w; f.h = r.h;
+    f.ox = r.ox; f.oy = r.oy;
+    f.firstVertex = r.firstVertex;
+    f.vertexCount = r.vertexCount;
+
+    // Center is the average of the outline, dimensions are from its bounds
+    if (f.vertexCount > 0) {
+      float left = 100000.f, right = -100000.f, top = 100000.f, bottom = -100000.f;
+      Vec2f sum(0,0);
+      for (unsigned v = f.firstVertex; v < f.firstVertex + f.vertexCount; v++) {
+	sum += vertices[v];
+	left   = std::min(left, vertices[v][0]);
+	right  = std::max(right, vertices[v][0]);
+	top    = std::min(top, vertices[v][1]);
+	bottom = std::max(bottom, vertices[v][1]);
       }
+      f.vbounds.first = sum / f.vertexCount;
+      f.vbounds.second = Vec2f(right-left, bottom-top) * .5f;
     }
-
-    /*std::cout << "  Frames: " << data.size() << std::endl;
-    for (Image::Frame &f : data)
-      std::cout << "    {"
-		<< f.x << ", "
-		<< f.y << ", "
-		<< f.w << ", "
-		<< f.h << ", "
-		<< f.ox << ", "
-		<< f.oy << "}" << std::endl;*/
   }
 }
 
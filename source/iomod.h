@@ -21,7 +21,8 @@ class IoMod
   SDL_Texture* readTexture(const std::string& filename);
   SDL_Surface* readSurface(const std::string& filename);
 
-  void readFrameData(const std::string&, std::vector<Image::Frame>&);
+  // Reads the '.frame' file next to an image, if there is one
+  void readFrameData(const std::string&, std::vector<Image::Frame>&, std::vector<Vec2f> &vertices);
 
   void writeText(const std::string&, int, int) const;
   void writeText(const std::string&, int, int, const SDL_Color &color) const;
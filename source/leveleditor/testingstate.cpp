@@ -3,11 +3,13 @@
 #include "viewport.h"
 #include "appstatemanager.h"
 #include "physicsmanager.h"
+#include "navgraph.h"
 
 #include "entity/actor.h"
 #include "entity/actorphysics.h"
 
 #include <SDL.h>
+#include <iostream>
 
 TestingState::TestingState( AppState* rs ) :
   returnState(rs), gamemgr( GameManager::getInstance() ), playerController(), playerActor(nullptr)
@@ -20,6 +22,9 @@ TestingState::~TestingState()
 
 void TestingState::enter()
 {
+  // The collision may have been edited since the scene was loaded
+  NavGraph::getInstance().build("");
+
   (playerActor = gamemgr.spawnActor("player", PhysicsManager::MASK_PLAYER,
 				    Viewport::getInstance().getMouseWorldPos(),
 				    Animation::DIR_RIGHT))->setPlayerControlled(&playerController);
@@ -43,6 +48,10 @@ void TestingState::input(const SDL_Event& event)
     case SDL_SCANCODE_A:     playerController.inputLeft(true);    break;
     case SDL_SCANCODE_D:     playerController.inputRight(true);   break;
     case SDL_SCANCODE_F1:    gamemgr.toggleDebugHUD(); break;
+    case SDL_SCANCODE_F3:
+      try { gamemgr.dumpStats("stats.json"); }
+      catch (const std::string &msg) { std::cout << msg << std::endl; }
+      break;
     case SDL_SCANCODE_F2:   AppStateManager::getInstance().changeState(returnState); break;
     default: break;
     }
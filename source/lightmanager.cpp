@@ -36,6 +36,39 @@ Light *LightManager::addLight( const Vec2f &pos, float s, float i )
   return &lights.back();
 }
 
+void LightManager::save(Snapshot &s) const
+{
+  s.ambience = ambience;
+  s.lights.clear();
+  for (const Light &l : lights)
+    if (!l.isDead()) s.lights.push_back({l.getPosition(), l.getSize(), l.getIntensity()});
+}
+
+int LightManager::find(const Light *light) const
+{
+  int index = 0;
+  for (const Light &l : lights) {
+    if (l.isDead()) continue;
+    if (&l == light) return index;
+    index++;
+  }
+  return -1;
+}
+
+std::vector<Light*> LightManager::restore(const Snapshot &s)
+{
+  ambience = s.ambience;
+  lights.clear();
+
+  std::vector<Light*> restored;
+  for (const Snapshot::LightData &l : s.lights) {
+    // The size is already scaled to the image
+    restored.push_back(addLight(l.position, 1.f, l.intensity));
+    restored.back()->setSize(l.size);
+  }
+  return restored;
+}
+
 void LightManager::update()
 {
   for (auto it = lights.begin(); it != lights.end();) {
@@ -4,6 +4,7 @@
 #include "vector2.h"
 
 #include <list>
+#include <vector>
 
 class Image;
 
@@ -62,6 +63,29 @@ class LightManager
 
   const Image *getLightImage() const { return lightImage; }
 
+  struct Snapshot
+  {
+    Snapshot() : ambience(0.f), lights() {}
+    struct LightData
+    {
+      LightData(const Vec2f &p = Vec2f(), float s = 0.f, float i = 0.f) : position(p), size(s), intensity(i) {}
+      Vec2f position;
+      float size, intensity;
+    };
+    float ambience;
+    std::vector<LightData> lights;
+  };
+
+  void save(Snapshot&) const;
+
+  // Where the light is in a saved snapshot, -1 if it's dead or not ours
+  int find(const Light*) const;
+
+  // Replaces every light. They come back in the same order, so the light at
+  // some index in the snapshot is the one at that index in the result.
+  // Pointers to the old lights are no good afterwards.
+  std::vector<Light*> restore(const Snapshot&);
+
   LightManager(const LightManager&) = delete;
   LightManager &operator=(const LightManager&) = delete;  
   
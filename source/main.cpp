@@ -1,14 +1,35 @@
 #include <iostream>
+#include <cstring>
 
 #include "gameconfig.h"
 #include "engine.h"
 #include "gamestate.h"
+#include "rendercontext.h"
+
+// ./run                                play
+// ./run --record file                  play, and save the session to file
+// ./run --replay file [--timing csv]   play a session back as fast as possible
+//       [--headless]                   without showing a window (set
+//                                      SDL_AUDIODRIVER=dummy for no sound too)
+int main(int argc, char *argv[]) {
+  std::string recordFile, replayFile, timingFile;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--headless") == 0) RenderContext::setHeadless(true);
+    else if (i+1 < argc && strcmp(argv[i], "--record") == 0) recordFile = argv[++i];
+    else if (i+1 < argc && strcmp(argv[i], "--replay") == 0) replayFile = argv[++i];
+    else if (i+1 < argc && strcmp(argv[i], "--timing") == 0) timingFile = argv[++i];
+    else {
+      std::cout << "Don't know what to do with " << argv[i] << std::endl;
+      return 1;
+    }
+  }
 
-int main(int, char*[]) {
   try {
     Engine engine;
     GameState state;
-    engine.play(&state);
+    if (!replayFile.empty()) engine.replay(&state, replayFile, timingFile);
+    else if (!recordFile.empty()) engine.record(&state, recordFile);
+    else engine.play(&state);
   }
   catch (const std::string& msg) { std::cout << msg << std::endl; }
   catch (std::exception &e) { std::cout << e.what() << std::endl; }
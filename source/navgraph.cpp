@@ -0,0 +1,425 @@
+#include "navgraph.h"
+#include "physicsmanager.h"
+#include "gameconfig.h"
+
+#include "entity/actorphysics.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <queue>
+#include <cstring>
+#include <cmath>
+
+const float MAX_SLOPE = 0.7f;
+const float NODE_SNAP = 32.f; // How far off the ground findNode still counts as standing on it
+const char NAV_MAGIC[4] = {'N','A','V','1'};
+
+NavGraph &NavGraph::getInstance()
+{
+  static NavGraph instance;
+  return instance;
+}
+
+NavGraph::NavGraph() :
+  spanGap(GameConfig::getInstance().get().navigation.spanGap),
+  edgeMargin(GameConfig::getInstance().get().navigation.edgeMargin),
+  clearance(GameConfig::getInstance().get().navigation.clearance),
+  maxLinkDist(GameConfig::getInstance().get().navigation.maxLinkDist),
+  nodes(),
+  links(),
+  columns(),
+  capabilities(),
+  incoming(),
+  incomingStart(),
+  flowFields(),
+  flowRebuilds(0),
+  cost(),
+  entry(),
+  done()
+{}
+
+float NavGraph::Node::getHeightAt(float x) const
+{
+  if (x <= points.front()[0]) return points.front()[1];
+  for (size_t i = 1; i < points.size(); i++) {
+    if (x <= points[i][0]) {
+      const Vec2f &a = points[i-1], &b = points[i];
+      float w = b[0] - a[0];
+      return w > 0.f ? a[1] + (b[1]-a[1]) * (x-a[0]) / w : b[1];
+    }
+  }
+  return points.back()[1];
+}
+
+void NavGraph::clear()
+{
+  nodes.clear();
+  links.clear();
+  columns.clear();
+  incoming.clear();
+  incomingStart.clear();
+  flowFields.clear();
+}
+
+void NavGraph::build(const std::string &scene)
+{
+  clear();
+
+  // Without a scene name (i.e. the editor testing unsaved collision) there's nothing to cache to
+  std::string file = scene.empty() ? "" : "assets/scenes/" + scene + ".nav";
+  unsigned long long hash = hashWorld();
+
+  if (file.empty() || !readCache(file, hash)) {
+    buildNodes();
+    buildLinks();
+    if (!file.empty()) writeCache(file, hash);
+  }
+  buildColumns();
+
+  std::cout << "Navigation: " << nodes.size() << " nodes, " << links.size() << " links" << std::endl;
+}
+
+void NavGraph::buildNodes()
+{
+  // Gather the walkable segments, left end first
+  std::vector<Segment> walkable;
+  PhysicsManager::getInstance().queryAllSegments([&walkable](const Segment &s) {
+      Vec2f normal = s[0]-s[1];
+      normal = Vec2f(-normal[1], normal[0]).normalize();
+      if (normal[1] >= -MAX_SLOPE) return;
+      if (s[0][0] <= s[1][0]) walkable.emplace_back(s[0], s[1]);
+      else walkable.emplace_back(s[1], s[0]);
+    });
+
+  std::sort(walkable.begin(), walkable.end(), [](const Segment &a, const Segment &b) {
+      return a[0][0] < b[0][0]; });
+
+  // Chain together segments whose ends meet
+  std::vector<bool> used(walkable.size(), false);
+  for (size_t i = 0; i < walkable.size(); i++) {
+    if (used[i]) continue;
+
+    // Only start chains at segments nothing connects into from the left
+    bool hasLeft = false;
+    for (size_t j = 0; j < walkable.size() && !hasLeft; j++)
+      hasLeft = j != i && !used[j] && (walkable[j][1] - walkable[i][0]).length() <= spanGap;
+    if (hasLeft) continue;
+
+    Node node;
+    node.points.push_back(walkable[i][0]);
+    node.points.push_back(walkable[i][1]);
+    used[i] = true;
+
+    for (bool extended = true; extended; ) {
+      extended = false;
+      for (size_t j = 0; j < walkable.size(); j++) {
+	if (used[j] || (walkable[j][0] - node.points.back()).length() > spanGap) continue;
+	node.points.push_back(walkable[j][1]);
+	used[j] = true;
+	extended = true;
+	break;
+      }
+    }
+    nodes.push_back(node);
+  }
+
+  // Whatever is left is part of a loop, which can't really happen with ground
+  // going left to right, but don't lose it
+  for (size_t i = 0; i < walkable.size(); i++) {
+    if (used[i]) continue;
+    Node node;
+    node.points.push_back(walkable[i][0]);
+    node.points.push_back(walkable[i][1]);
+    nodes.push_back(node);
+  }
+}
+
+void NavGraph::buildLinks()
+{
+  PhysicsManager &physics = PhysicsManager::getInstance();
+  Vec2f lift(0, -clearance);
+
+  // Goes up (or stays level), then across, then down, making sure nothing is in the way
+  auto clearArc = [&physics, &lift](const Vec2f &takeoff, const Vec2f &landing) {
+    float apex = std::min(takeoff[1], landing[1]) + lift[1];
+    Vec2f p0 = takeoff + lift, p1(takeoff[0], apex), p2(landing[0], apex), p3 = landing + lift;
+    return physics.lineOfSight(p0, p1) && physics.lineOfSight(p1, p2) && physics.lineOfSight(p2, p3);
+  };
+
+  auto tryLink = [&](int from, int to, const Vec2f &takeoff, const Vec2f &landing) {
+    if (fabs(landing[0] - takeoff[0]) > maxLinkDist || fabs(landing[1] - takeoff[1]) > maxLinkDist) return;
+    if (!clearArc(takeoff, landing)) return;
+    links.push_back(Link{from, to, takeoff, landing});
+  };
+
+  for (int a = 0; a < (int)nodes.size(); a++) {
+    const Node &from = nodes[a];
+    for (int b = 0; b < (int)nodes.size(); b++) {
+      if (a == b) continue;
+      const Node &to = nodes[b];
+
+      // Off the right end
+      if (to.getRight() > from.getRight()) {
+	float tx = std::max(from.getRight() - edgeMargin, from.getLeft()),
+	  lx = std::min(std::max(from.getRight() + edgeMargin, to.getLeft() + edgeMargin), to.getRight());
+	tryLink(a, b, Vec2f(tx, from.getHeightAt(tx)), Vec2f(lx, to.getHeightAt(lx)));
+      }
+
+      // Off the left end
+      if (to.getLeft() < from.getLeft()) {
+	float tx = std::min(from.getLeft() + edgeMargin, from.getRight()),
+	  lx = std::max(std::min(from.getLeft() - edgeMargin, to.getRight() - edgeMargin), to.getLeft());
+	tryLink(a, b, Vec2f(tx, from.getHeightAt(tx)), Vec2f(lx, to.getHeightAt(lx)));
+      }
+
+      // Straight up onto ground overhead. Ground can be jumped through from
+      // below, but the underside of a solid block can't, which clearArc catches.
+      float left = std::max(from.getLeft(), to.getLeft()), right = std::min(from.getRight(), to.getRight());
+      if (left < right) {
+	float x = (left + right) * .5f;
+	if (to.getHeightAt(x) < from.getHeightAt(x) - clearance) {
+	  Vec2f takeoff(x, from.getHeightAt(x)), landing(x, to.getHeightAt(x));
+	  if (takeoff[1] - landing[1] <= maxLinkDist &&
+	      physics.lineOfSight(takeoff + lift, landing - lift))
+	    links.push_back(Link{a, b, takeoff, landing});
+	}
+      }
+    }
+  }
+}
+
+void NavGraph::buildColumns()
+{
+  // Links are made in order of their starting node, so each node's links are in one run
+  for (Node &n : nodes) n.linkCount = 0;
+  for (int i = (int)links.size()-1; i >= 0; i--) {
+    nodes[links[i].from].firstLink = i;
+    nodes[links[i].from].linkCount++;
+  }
+
+  incomingStart.assign(nodes.size()+1, 0);
+  for (const Link &l : links) incomingStart[l.to+1]++;
+  for (size_t n = 0; n < nodes.size(); n++) incomingStart[n+1] += incomingStart[n];
+  incoming.resize(links.size());
+  std::vector<int> fill(incomingStart.begin(), incomingStart.end()-1);
+  for (int i = 0; i < (int)links.size(); i++) incoming[fill[links[i].to]++] = i;
+
+  columns.resize(PhysicsManager::getInstance().getWorldWidth()/COLUMN_SIZE + 1);
+  for (int i = 0; i < (int)nodes.size(); i++) {
+    int first = std::max(0, (int)((nodes[i].getLeft() - NODE_SNAP)/COLUMN_SIZE)),
+      last = std::min((int)columns.size()-1, (int)((nodes[i].getRight() + NODE_SNAP)/COLUMN_SIZE));
+    for (int c = first; c <= last; c++) columns[c].push_back(i);
+  }
+}
+
+int NavGraph::findNode(const Vec2f &pos) const
+{
+  int c = pos[0]/COLUMN_SIZE;
+  if (pos[0] < 0.f || c >= (int)columns.size()) return -1;
+
+  int best = -1;
+  float bestDist = NODE_SNAP;
+  for (int i : columns[c]) {
+    const Node &n = nodes[i];
+    if (pos[0] < n.getLeft() - NODE_SNAP || pos[0] > n.getRight() + NODE_SNAP) continue;
+    float dist = fabs(n.getHeightAt(pos[0]) - pos[1]);
+    if (dist <= bestDist) {
+      best = i;
+      bestDist = dist;
+    }
+  }
+  return best;
+}
+
+int NavGraph::linkAction(const Link &l, const Capability &c)
+{
+  float dx = fabs(l.landing[0] - l.takeoff[0]), rise = l.takeoff[1] - l.landing[1];
+
+  // Walk off the edge and steer while falling
+  if (rise <= 0.f && c.airSpeed * sqrtf(-2.f*rise / c.gravity) >= dx)
+    return 1;
+
+  // Jump. Up to the peak, then fall down to the landing height.
+  float peak = c.jumpSpeed*c.jumpSpeed / (2.f*c.gravity);
+  if (rise > peak) return 0;
+  float time = c.jumpSpeed / c.gravity + sqrtf(2.f*(peak - rise) / c.gravity);
+  return c.airSpeed * time >= dx ? 2 : 0;
+}
+
+unsigned NavGraph::getCapability(const ActorPhysics &physics)
+{
+  Capability cap{ PhysicsManager::GRAVITY * physics.getFallFactor(), physics.getJumpStrength(), physics.getAirSpeed() };
+  auto it = std::find(capabilities.begin(), capabilities.end(), cap);
+  if (it != capabilities.end()) return it - capabilities.begin();
+  capabilities.push_back(cap);
+  return capabilities.size()-1;
+}
+
+const NavGraph::Step *NavGraph::getFlowStep(const Entity *target, int targetNode, int from, const ActorPhysics &physics)
+{
+  if (from == targetNode) return nullptr;
+
+  unsigned capId = getCapability(physics);
+  FlowField &field = flowFields[std::make_pair(target, capId)];
+  if (field.targetNode != targetNode) buildFlowField(field, targetNode, capabilities[capId]);
+
+  const Step &step = field.next[from];
+  return step.link >= 0 ? &step : nullptr;
+}
+
+void NavGraph::forgetTarget(const Entity *target)
+{
+  auto it = flowFields.lower_bound(std::make_pair(target, 0u));
+  while (it != flowFields.end() && it->first.first == target) it = flowFields.erase(it);
+}
+
+void NavGraph::buildFlowField(FlowField &field, int targetNode, const Capability &cap)
+{
+  flowRebuilds++;
+  field.targetNode = targetNode;
+  field.next.assign(nodes.size(), Step{-1, false});
+
+  // Dijkstra backwards from the target. entry[n] is where we leave node n on the
+  // way to the target, so walking across a node to its exit counts too.
+  cost.assign(nodes.size(), INFINITY);
+  done.assign(nodes.size(), false);
+  entry.assign(nodes.size(), Vec2f(0,0));
+
+  typedef std::pair<float,int> Open;
+  std::priority_queue< Open, std::vector<Open>, std::greater<Open> > open;
+  const Node &goal = nodes[targetNode];
+  cost[targetNode] = 0.f;
+  entry[targetNode] = Vec2f((goal.getLeft() + goal.getRight()) * .5f, 0.f);
+  open.push(Open(0.f, targetNode));
+
+  while (!open.empty()) {
+    int n = open.top().second;
+    open.pop();
+    if (done[n]) continue;
+    done[n] = true;
+
+    for (int i = incomingStart[n]; i < incomingStart[n+1]; i++) {
+      const Link &l = links[incoming[i]];
+      if (done[l.from]) continue;
+      int action = linkAction(l, cap);
+      if (action == 0) continue;
+
+      float c = cost[n] + fabs(entry[n][0] - l.landing[0]) + (l.landing - l.takeoff).length();
+      if (c < cost[l.from]) {
+	cost[l.from] = c;
+	entry[l.from] = l.takeoff;
+	field.next[l.from] = Step{incoming[i], action == 2};
+	open.push(Open(c, l.from));
+      }
+    }
+  }
+}
+
+unsigned long long NavGraph::hashWorld() const
+{
+  // FNV-1a over each segment, summed so the order the grid keeps them in
+  // doesn't matter, then over the build settings
+  auto add = [](unsigned long long &hash, float f) {
+    unsigned char bytes[sizeof(float)];
+    memcpy(bytes, &f, sizeof(float));
+    for (unsigned char b : bytes) {
+      hash ^= b;
+      hash *= 1099511628211ULL;
+    }
+  };
+
+  unsigned long long hash = 0;
+  PhysicsManager::getInstance().queryAllSegments([&add, &hash](const Segment &s) {
+      unsigned long long h = 14695981039346656037ULL;
+      add(h, s[0][0]); add(h, s[0][1]); add(h, s[1][0]); add(h, s[1][1]);
+      hash += h; });
+  add(hash, spanGap); add(hash, edgeMargin); add(hash, clearance); add(hash, maxLinkDist);
+  return hash;
+}
+
+bool NavGraph::readCache(const std::string &file, unsigned long long hash)
+{
+  std::ifstream fin(file, std::ios::in | std::ios::binary);
+  if (!fin.is_open()) return false;
+
+  char magic[4];
+  unsigned long long fileHash;
+  fin.read(magic, 4);
+  fin.read((char*)&fileHash, sizeof(fileHash));
+  if (!fin || memcmp(magic, NAV_MAGIC, 4) != 0 || fileHash != hash) return false;
+
+  // A truncated or mangled cache just means building the graph again, so check
+  // every read, and never trust a count for more than what's left in the file
+  auto fail = [this]() {
+    nodes.clear();
+    links.clear();
+    return false;
+  };
+  std::streamoff start = fin.tellg();
+  fin.seekg(0, std::ios::end);
+  std::streamoff left = fin.tellg() - start;
+  fin.seekg(start);
+
+  unsigned nodeCount, linkCount;
+  fin.read((char*)&nodeCount, sizeof(unsigned));
+  if (!fin.good() || nodeCount > left / sizeof(unsigned)) return fail();
+  nodes.resize(nodeCount);
+  for (Node &n : nodes) {
+    unsigned pointCount;
+    fin.read((char*)&pointCount, sizeof(unsigned));
+    if (!fin.good() || pointCount > left / (2*sizeof(float))) return fail();
+    n.points.resize(pointCount);
+    for (Vec2f &p : n.points) {
+      fin.read((char*)&p[0], sizeof(float));
+      fin.read((char*)&p[1], sizeof(float));
+      if (!fin.good()) return fail();
+    }
+  }
+
+  fin.read((char*)&linkCount, sizeof(unsigned));
+  if (!fin.good() || linkCount > left / (2*sizeof(int) + 4*sizeof(float))) return fail();
+  links.resize(linkCount);
+  for (Link &l : links) {
+    fin.read((char*)&l.from, sizeof(int));
+    fin.read((char*)&l.to, sizeof(int));
+    fin.read((char*)&l.takeoff[0], sizeof(float));
+    fin.read((char*)&l.takeoff[1], sizeof(float));
+    fin.read((char*)&l.landing[0], sizeof(float));
+    fin.read((char*)&l.landing[1], sizeof(float));
+    if (!fin.good() || l.from < 0 || l.to < 0 || l.from >= (int)nodes.size() || l.to >= (int)nodes.size())
+      return fail();
+  }
+  return true;
+}
+
+void NavGraph::writeCache(const std::string &file, unsigned long long hash) const
+{
+  std::ofstream fout(file, std::ios::out | std::ios::binary);
+  if (!fout.is_open()) {
+    std::cout << "Couldn't write navigation cache " << file << std::endl;
+    return;
+  }
+
+  fout.write(NAV_MAGIC, 4);
+  fout.write((const char*)&hash, sizeof(hash));
+
+  unsigned nodeCount = nodes.size(), linkCount = links.size();
+  fout.write((const char*)&nodeCount, sizeof(unsigned));
+  for (const Node &n : nodes) {
+    unsigned pointCount = n.points.size();
+    fout.write((const char*)&pointCount, sizeof(unsigned));
+    for (const Vec2f &p : n.points) {
+      float xy[2] = { p[0], p[1] };
+      fout.write((const char*)xy, sizeof(xy));
+    }
+  }
+
+  fout.write((const char*)&linkCount, sizeof(unsigned));
+  for (const Link &l : links) {
+    fout.write((const char*)&l.from, sizeof(int));
+    fout.write((const char*)&l.to, sizeof(int));
+    float points[4] = { l.takeoff[0], l.takeoff[1], l.landing[0], l.landing[1] };
+    fout.write((const char*)points, sizeof(points));
+  }
+}
@@ -0,0 +1,142 @@
+#ifndef NAVGRAPH_H
+#define NAVGRAPH_H
+
+#include <vector>
+#include <string>
+#include <map>
+
+#include "vector2.h"
+
+class ActorPhysics;
+class Entity;
+
+/*
+ * Where enemies can go. Connected runs of walkable world segments become
+ * nodes, and places where an actor could jump or drop from one node to
+ * another become links. Links don't depend on any particular actor; whether
+ * an actor can make a jump is decided when a flow field is built, from its
+ * jump strength, air speed and gravity.
+ *
+ * The graph is built when a scene loads and saved next to the scene, so it
+ * only has to be rebuilt when the collision changes.
+ */
+class NavGraph
+{
+ public:
+  static NavGraph &getInstance();
+
+  // A stretch of ground that can be walked along without jumping. Points go
+  // from left to right.
+  struct Node
+  {
+    Node() : points(), firstLink(0), linkCount(0) {}
+    std::vector<Vec2f> points;
+    int firstLink, linkCount;
+
+    float getLeft() const { return points.front()[0]; }
+    float getRight() const { return points.back()[0]; }
+    float getHeightAt(float x) const;
+  };
+
+  // A jump or drop from the takeoff point on one node to the landing point on another
+  struct Link
+  {
+    Link() : from(-1), to(-1), takeoff(), landing() {}
+    Link(int f, int t, const Vec2f &a, const Vec2f &b) : from(f), to(t), takeoff(a), landing(b) {}
+    int from, to;
+    Vec2f takeoff, landing;
+  };
+
+  struct Step
+  {
+    int link;
+    bool jump; // false if the actor can just walk off and fall
+  };
+
+  // Builds the graph out of the PhysicsManager's world segments, or loads it
+  // from the scene's cache file if the segments haven't changed. An empty
+  // scene name always builds and doesn't touch the disk.
+  void build(const std::string &scene);
+  void clear();
+
+  // The node whose ground is right under the position, or -1
+  int findNode(const Vec2f &position) const;
+
+  // The first step from a node toward wherever the target is. Every actor
+  // chasing the same target (with the same movement abilities) shares one
+  // flow field, which is only worked out again when the target moves onto
+  // another node, so this is just a lookup for each of them. Returns nullptr if
+  // the target can't be reached or there's no need to leave the node.
+  const Step *getFlowStep(const Entity *target, int targetNode, int from, const ActorPhysics&);
+
+  // Drops the target's flow fields. Called when it goes away, since pooled
+  // entities come back as someone else.
+  void forgetTarget(const Entity *target);
+
+  const Node &getNode(int id) const { return nodes[id]; }
+  const Link &getLink(int id) const { return links[id]; }
+  int getNodeCount() const { return nodes.size(); }
+  int getLinkCount() const { return links.size(); }
+  int getFlowFieldCount() const { return flowFields.size(); }
+  int getFlowRebuilds() const { return flowRebuilds; }
+
+  NavGraph(const NavGraph&) = delete;
+  NavGraph &operator=(const NavGraph&) = delete;
+
+ private:
+  NavGraph();
+
+  // Build settings
+  const float spanGap;     // Walkable segments with ends this close are joined
+  const float edgeMargin;  // How far in from the end of a node jumps take off
+  const float clearance;   // How far above the ground a jump has to stay clear of walls
+  const float maxLinkDist; // Links longer than this (horizontally or vertically) are never made
+
+  std::vector<Node> nodes;
+  std::vector<Link> links;
+
+  // Nodes by horizontal slice of the world, for findNode
+  const static int COLUMN_SIZE = 512;
+  std::vector< std::vector<int> > columns;
+
+  // What an actor can do in the air
+  struct Capability
+  {
+    float gravity, jumpSpeed, airSpeed;
+    bool operator==(const Capability &c) const {
+      return gravity == c.gravity && jumpSpeed == c.jumpSpeed && airSpeed == c.airSpeed; }
+  };
+  std::vector<Capability> capabilities;
+  unsigned getCapability(const ActorPhysics&);
+
+  // Links coming into each node, for searching backwards from a target
+  std::vector<int> incoming, incomingStart;
+
+  // For every node, the link to take next to get to the target node
+  struct FlowField
+  {
+    FlowField() : targetNode(-1), next() {}
+    int targetNode;
+    std::vector<Step> next; // link -1 where there is no way
+  };
+  std::map< std::pair<const Entity*, unsigned>, FlowField > flowFields;
+  int flowRebuilds;
+  void buildFlowField(FlowField&, int targetNode, const Capability&);
+
+  // Scratch space for the search
+  std::vector<float> cost;
+  std::vector<Vec2f> entry;
+  std::vector<bool> done;
+
+  void buildNodes();
+  void buildLinks();
+  void buildColumns();
+  unsigned long long hashWorld() const;
+  bool readCache(const std::string &file, unsigned long long hash);
+  void writeCache(const std::string &file, unsigned long long hash) const;
+
+  // Returns 0 if the link can't be taken, 1 if the actor can walk off and fall, 2 if it has to jump
+  static int linkAction(const Link&, const Capability&);
+};
+
+#endif
@@ -1,11 +1,14 @@
 #include "physicsmanager.h"
-#include "gamemanager.h"
-#include "stringutil.h"
+#include "stats.h"
 
 #include <iostream>
 #include <map>
+#include <cmath>
 
-PhysicsManager::PhysicsManager() : width(0), height(0), grid(), entityIndex() {}
+PhysicsManager::PhysicsManager() : width(0), height(0), grid(), entityIndex(), segmentCells{{0, 0}, {-1, -1}},
+  packedSegments(), segmentByID(), bvh(), packedDirty(false), useBVH(true),
+  batchOrder(), batchSegments(), walkQuery(0),
+  statIntersections(Stats::getInstance().add("physics.intersections", Stats::GAUGE)) {}
 
 PhysicsManager &PhysicsManager::getInstance()
 {
@@ -13,10 +16,23 @@ PhysicsManager &PhysicsManager::getInstance()
   return instance;
 }
 
+size_t PhysicsManager::getGridMemory() const
+{
+  // List nodes are the element plus two pointers
+  size_t bytes = grid.getMemoryUsage() + packedSegments.capacity() * sizeof(Segment) +
+    segmentByID.capacity() * sizeof(int) + bvh.getMemoryUsage();
+  grid.forEach([&bytes](const CellKey&, const GridBox &b) {
+      bytes += b.worldSegments.size() * (sizeof(Segment) + 2*sizeof(void*))
+	+ b.entities.size() * 3*sizeof(void*); });
+  return bytes;
+}
+
 void PhysicsManager::updateEntityList()
 {
-  for (int gridPos = 0; gridPos < (width/GRID_SIZE)*(height/GRID_SIZE); gridPos++) {
-    auto &list = grid[gridPos].entities;
+  std::vector< std::pair<Entity*, CellKey> > moved;
+
+  grid.forEach([&](const CellKey &cell, GridBox &b) {
+    auto &list = b.entities;
     for (auto it = list.begin(); it != list.end();) {
       Entity *e = *it;
 
@@ -27,17 +43,22 @@ void PhysicsManager::updateEntityList()
       }
 
       // Next, make sure they all lie within the right grid box
-      int ex = (int)(e->getPosition()[0])/GRID_SIZE,
-	ey = (int)(e->getPosition()[1])/GRID_SIZE;
-      int ePos = ex + ey*(width/GRID_SIZE);
-      
-      if (ePos != gridPos) {
-	entityIndex[(unsigned long)e] = ePos;
-	grid[ePos].entities.push_back(e);
+      CellKey eCell = getCell(e->getPosition());
+      if (eCell != cell) {
+	moved.emplace_back(e, eCell);
 	it = list.erase(it);
       }
       else ++it;
     }
+
+    // Don't keep cells around for nothing
+    if (list.empty() && b.worldSegments.empty()) grid.erase(cell);
+  });
+
+  // Moved afterwards, since adding cells while going through them isn't safe
+  for (auto &m : moved) {
+    entityIndex[(unsigned long)m.first] = m.second;
+    grid[m.second].entities.push_back(m.first);
   }
 }
 
@@ -46,7 +67,8 @@ void PhysicsManager::testEntityCollisions()
   // Test all entity intersections in ~O(N log N) time!
   
   std::list<Entity*> testList;
-  for (GridBox &b : grid) std::for_each(b.entities.begin(), b.entities.end(), [&](Entity*e) { testList.push_back(e); });
+  grid.forEach([&testList](const CellKey&, const GridBox &b) {
+      testList.insert(testList.end(), b.entities.begin(), b.entities.end()); });
   if (testList.size() == 0) return;
   testList.sort([&](Entity*a, Entity*b) { return a->getBoundingBox()[0] < b->getBoundingBox()[0]; } );
   std::map<Entity*, std::list<Entity*>> xIntersections;
@@ -85,7 +107,101 @@ void PhysicsManager::testEntityCollisions()
     }
   }
 
-  GameManager::getInstance().setDebugMessage(3, "Entity Intersections: " + StringUtil::toString(intersections));
+  Stats::getInstance().set(statIntersections, intersections);
+}
+
+void PhysicsManager::packSegments()
+{
+  packedSegments.clear();
+  grid.forEach([this](const CellKey&, GridBox &b) {
+      b.packedFirst = packedSegments.size();
+      packedSegments.insert(packedSegments.end(), b.worldSegments.begin(), b.worldSegments.end());
+      b.packedLast = packedSegments.size(); });
+
+  segmentByID.clear();
+  for (unsigned i = 0; i < packedSegments.size(); i++) {
+    int id = packedSegments[i].getID();
+    if (id < 0) continue;
+    if (id >= static_cast<int>(segmentByID.size())) segmentByID.resize(id+1, -1);
+    segmentByID[id] = i;
+  }
+  bvh.build(packedSegments.begin(), packedSegments.end());
+  packedDirty = false;
+}
+
+template <typename F>
+bool PhysicsManager::walkSegments(const Vec2f &a, const Vec2f &b, F &&f, const float *maxT)
+{
+  if (useBVH) {
+    if (packedDirty) packSegments();
+    return bvh.queryRay(a, b, f, maxT);
+  }
+
+  // Only the part of the line near cells with segments matters, which keeps
+  // lines that run far out of the world from walking through empty space
+  Vec2f d = b - a;
+  float t0 = 0.f, t1 = 1.f;
+  {
+    const CellRange &r = segmentCells;
+    if (r.min.x > r.max.x) return false;
+    float lo[2] = { (r.min.x-1.f)*GRID_SIZE, (r.min.y-1.f)*GRID_SIZE },
+      hi[2] = { (r.max.x+2.f)*GRID_SIZE, (r.max.y+2.f)*GRID_SIZE };
+    for (int i = 0; i < 2; i++) {
+      if (d[i] == 0.f) {
+	if (a[i] < lo[i] || a[i] > hi[i]) return false;
+	continue;
+      }
+      float ta = (lo[i] - a[i]) / d[i], tb = (hi[i] - a[i]) / d[i];
+      t0 = std::max(t0, std::min(ta, tb));
+      t1 = std::min(t1, std::max(ta, tb));
+    }
+    if (!(t0 <= t1)) return false;
+  }
+
+  if (packedDirty) packSegments();
+  if (++walkQuery == 0) {
+    grid.forEach([](const CellKey&, GridBox &b) { b.walkStamp = 0; });
+    walkQuery = 1;
+  }
+
+  // Segments live in the cell of their center, so a segment crossing a cell may
+  // be stored in any of its neighbours. Visit the 3x3 block around every cell
+  // the line passes through, skipping cells already visited.
+  auto visitAround = [&](int cx, int cy) {
+    for (int x = cx-1; x <= cx+1; x++) {
+      for (int y = cy-1; y <= cy+1; y++) {
+	GridBox *b = grid.find(CellKey{x, y});
+	if (b == nullptr || b->walkStamp == walkQuery) continue;
+	b->walkStamp = walkQuery;
+
+	for (const Segment *s = packedSegments.data() + b->packedFirst; s != packedSegments.data() + b->packedLast; ++s)
+	  if (f(*s)) return true;
+      }
+    }
+    return false;
+  };
+
+  // Walk the cells along the line (Amanatides & Woo)
+  Vec2f start = a + d*t0, end = a + d*t1;
+  d = end - start;
+  float fx = start[0]/GRID_SIZE, fy = start[1]/GRID_SIZE;
+  int x = cellCoord(start[0]), y = cellCoord(start[1]),
+    endX = cellCoord(end[0]), endY = cellCoord(end[1]),
+    stepX = d[0] > 0.f ? 1 : -1, stepY = d[1] > 0.f ? 1 : -1;
+
+  float deltaX = d[0] != 0.f ? fabs(GRID_SIZE / d[0]) : INFINITY,
+    deltaY = d[1] != 0.f ? fabs(GRID_SIZE / d[1]) : INFINITY,
+    maxX = d[0] != 0.f ? (stepX > 0 ? (x+1) - fx : fx - x) * deltaX : INFINITY,
+    maxY = d[1] != 0.f ? (stepY > 0 ? (y+1) - fy : fy - y) * deltaY : INFINITY;
+
+  while (true) {
+    if (visitAround(x, y)) return true;
+    if ((x == endX && y == endY) || (maxX > 1.f && maxY > 1.f)) break;
+    if (maxX < maxY) { x += stepX; maxX += deltaX; }
+    else { y += stepY; maxY += deltaY; }
+  }
+
+  return false;
 }
 
 PhysicsManager::RayResult PhysicsManager::rayCast(int mask, const Vec2f &a, const Vec2f &b)
@@ -94,16 +210,13 @@ PhysicsManager::RayResult PhysicsManager::rayCast(int mask, const Vec2f &a, cons
 
   (void)mask; (void)a; (void)b;
 
-  Vec2f center( (a+b)*.5f ),
-    hdim( fabs(a[0]-b[0])*.5f, fabs(a[1]-b[1])*.5f );
-
   if (mask & MASK_WORLD) {
-    querySegmentGridArea(center, 1, [&](const Segment &s) {
+    walkSegments(a, b, [&](const Segment &s) {
       Vec2f normal = s[0]-s[1];
       normal = Vec2f(-normal[1], normal[0]);
 
       if (normal.dot(a-b) < 0)
-	return;
+	return false;
 
       auto ray = raySegmentIntersect(a, b, s[0], s[1]);
 		
@@ -114,20 +227,81 @@ PhysicsManager::RayResult PhysicsManager::rayCast(int mask, const Vec2f &a, cons
 	result.normal = normal.normalize();
 	result.c = s[0];
 	result.d = s[1];
+	result.segment = s.getID();
       }
-    } );
+      return false;
+    }, &result.t );
   }
 
   return result;
 }
 
+void PhysicsManager::rayCastBatch(int mask, int count, const float *ax, const float *ay, const float *dx, const float *dy,
+				  float *t, float *nx, float *ny)
+{
+  for (int i = 0; i < count; i++) t[i] = 1.f;
+  if (!(mask & MASK_WORLD) || count == 0) return;
+
+  // Sort the rays by the grid cell of their midpoints (what rayCast queries around)
+  // Rays long enough to leave the cells around their midpoint get cast on their own
+  batchOrder.clear();
+  for (int i = 0; i < count; i++) {
+    if (fabs(dx[i]) > GRID_SIZE/2 || fabs(dy[i]) > GRID_SIZE/2) {
+      RayResult result = rayCast(mask, Vec2f(ax[i], ay[i]), Vec2f(ax[i]+dx[i], ay[i]+dy[i]));
+      if (result.hit) {
+	t[i] = result.t;
+	nx[i] = result.normal[0];
+	ny[i] = result.normal[1];
+      }
+      continue;
+    }
+    batchOrder.emplace_back(getCell(Vec2f(ax[i] + dx[i]*.5f, ay[i] + dy[i]*.5f)), i);
+  }
+  std::sort(batchOrder.begin(), batchOrder.end());
+  int bucketed = batchOrder.size();
+
+  for (int start = 0, end; start < bucketed; start = end) {
+    CellKey cell = batchOrder[start].first;
+    for (end = start+1; end < bucketed && batchOrder[end].first == cell; end++) {}
+
+    batchSegments.clear();
+    queryGridRange(Vec2f((cell.x + .5f)*GRID_SIZE, (cell.y + .5f)*GRID_SIZE), 1, [this](const CellKey &c) {
+	for (const Segment &s : getCellSegments(c)) batchSegments.push_back(&s); });
+
+    for (int r = start; r < end; r++) {
+      int i = batchOrder[r].second;
+      Vec2f a(ax[i], ay[i]), b(ax[i]+dx[i], ay[i]+dy[i]);
+      for (const Segment *s : batchSegments) {
+	Vec2f normal = (*s)[0]-(*s)[1];
+	normal = Vec2f(-normal[1], normal[0]);
+	if (normal.dot(a-b) < 0) continue;
+
+	auto ray = raySegmentIntersect(a, b, (*s)[0], (*s)[1]);
+	if (ray.first >= 0.f && ray.first < t[i] && ray.second >= 0.f && ray.second <= 1.f) {
+	  t[i] = ray.first;
+	  normal = normal.normalize();
+	  nx[i] = normal[0];
+	  ny[i] = normal[1];
+	}
+      }
+    }
+  }
+}
+
+bool PhysicsManager::lineOfSight(const Vec2f &a, const Vec2f &b)
+{
+  return !walkSegments(a, b, [&a, &b](const Segment &s) {
+      auto ray = raySegmentIntersect(a, b, s[0], s[1]);
+      return ray.first >= 0.f && ray.first <= 1.f && ray.second >= 0.f && ray.second <= 1.f; });
+}
+
 PhysicsManager::RayResult PhysicsManager::multiPlaneCast(int mask, const Vec2f &dir, const std::vector<Vec2f> &points)
 {
   RayResult result;
 
   (void)mask; (void)dir; (void)points;
 
-  Vec2f min(10000,10000), max(-10000,-10000), center, hdim;
+  Vec2f min(INFINITY,INFINITY), max(-INFINITY,-INFINITY), center, hdim;
 
   {
     size_t s = points.size();
@@ -161,22 +335,29 @@ PhysicsManager::RayResult PhysicsManager::multiPlaneCast(int mask, const Vec2f &
   xmax = std::min(xmax, width/GRID_SIZE);
   ymax = std::min(ymax, height/GRID_SIZE);*/
 
+  // Follow the box along the whole move. Fast actors (thrown ones especially,
+  // or anything at a low frame rate) can move further than the cells around
+  // the middle of the move.
+  Vec2f from(0,0);
+  for (const Vec2f &p : points) from += p;
+  from = from / points.size();
+
   // If we are to detect collisions for backdrops, do so
-  if (mask & MASK_WORLD) {    
-    querySegmentGridArea( center, 1, [&](const Segment &s) {
-      
+  if (mask & MASK_WORLD) {
+    auto test = [&](const Segment &s) {
+
 	// Now test to make sure there is a potential intersection between the
       // planecast and the current edge. If not, skip it.
       Vec2f cd_center( (s[0]+s[1])*.5f ),
 	cd_hdim( fabs(s[0][0]-s[1][0])*.5f, fabs(s[0][1]-s[1][1])*.5f );
       if (!boxIntersection( center, hdim, cd_center, cd_hdim ))
-	return;
+	return false;
 
       // Determine the direction the wall plane is facing, and cancel the check if it's
       // facing the outside direction
       Vec2f normal = s[0]-s[1];
       normal = Vec2f(-normal[1], normal[0]).normalize();
-      if (normal.dot(dir) > 0) return;
+      if (normal.dot(dir) > 0) return false;
 
       // Do a normal raycast from all the corners
       for (const Vec2f &p : points) {
@@ -191,6 +372,7 @@ PhysicsManager::RayResult PhysicsManager::multiPlaneCast(int mask, const Vec2f &
 	  result.normal = normal;
 	  result.c = s[0];
 	  result.d = s[1];
+	  result.segment = s.getID();
 	  result.corner = false;
 	  result.hit = true;
 	  //result.cornerData.resize(0);
@@ -221,6 +403,7 @@ PhysicsManager::RayResult PhysicsManager::multiPlaneCast(int mask, const Vec2f &
 	      //result.u = ray.second;
 	      result.normal = Vec2f(-result.normal[1], result.normal[0]).normalize();
 	      result.corner = true;
+	      result.segment = -1;
 	      result.hit = true;
 	    }
 	  }
@@ -229,12 +412,26 @@ PhysicsManager::RayResult PhysicsManager::multiPlaneCast(int mask, const Vec2f &
 	// Check points c and d
 	inBox(s[0]); inBox(s[1]);
       }
-    } ); // end querySegmentGridArea
+      return false;
+    };
+
+    // Everything the swept box touches, or the cells along the move
+    if (useBVH) {
+      if (packedDirty) packSegments();
+      bvh.queryBox(BoundingBox(min[0], min[1], max[0], max[1]), test);
+    }
+    else walkSegments( from, from + dir, test );
   }
 
   return result;
 }
 
+const Segment *PhysicsManager::nearestSegment(const Vec2f &position, float maxDist, Vec2f *closest)
+{
+  if (packedDirty) packSegments();
+  return bvh.nearest(position, maxDist, closest);
+}
+
 bool PhysicsManager::boxIntersection( const Vec2f &box1c, const Vec2f &box1h,
 				    const Vec2f &box2c, const Vec2f &box2h )
 {
@@ -269,6 +466,35 @@ bool PhysicsManager::boxCircleIntersection( const BoundingBox &bb, const Vec2f &
   return false;
 }
 
+bool PhysicsManager::convexCircleIntersection( const Vec2f *verts, const Vec2f *normals, unsigned count,
+					       const Vec2f &offset, const Vec2f &cpos, float crad )
+{
+  Vec2f c = cpos - offset;
+
+  // Edge normals, also finding the vertex closest to the circle on the way
+  unsigned closest = 0;
+  float closestDist = INFINITY;
+  for (unsigned i = 0; i < count; i++) {
+    if (normals[i].dot(c - verts[i]) > crad) return false;
+    float d = (c - verts[i]).lengthSquared();
+    if (d < closestDist) {
+      closestDist = d;
+      closest = i;
+    }
+  }
+
+  // Center sitting right on a vertex, so there's no axis to test
+  if (closestDist < 1e-6f) return true;
+
+  // The axis from the closest vertex to the circle's center. The hull lies behind
+  // the center along it, so it's separated if even its nearest point is past the radius
+  Vec2f axis = (c - verts[closest]).normalize();
+  float max = -INFINITY;
+  for (unsigned i = 0; i < count; i++)
+    max = std::max(max, axis.dot(verts[i] - c));
+  return max >= -crad;
+}
+
 std::pair<float,float> PhysicsManager::raySegmentIntersect(Vec2f a, Vec2f b, Vec2f c, Vec2f d)
 {
   Vec2f r = b-a;
@@ -316,29 +542,61 @@ Vec2f PhysicsManager::raySlide( const Vec2f &direction, const Vec2f &normal, flo
   return result.length() > PhysicsManager::EPSILON ? result : Vec2f(0,0);
 }
 
-Segment &PhysicsManager::addWorldSegment(const Vec2f &a, const Vec2f &b) {
-  Vec2f center = (a+b)*.5f;
-  int x = center[0]/GRID_SIZE;
-  int y = center[1]/GRID_SIZE;
-  int gridPos = x + y * (width/GRID_SIZE);
-  auto &list = grid[gridPos].worldSegments;//getSegmentList((a+b)*.5f);
-  list.emplace_back(a, b);
+Segment &PhysicsManager::addWorldSegment(const Segment &s) {
+  CellKey cell = getCell(s.getCenter());
+  CellRange &r = segmentCells;
+  if (r.min.x > r.max.x) r.min = r.max = cell;
+  r.min = { std::min(r.min.x, cell.x), std::min(r.min.y, cell.y) };
+  r.max = { std::max(r.max.x, cell.x), std::max(r.max.y, cell.y) };
+
+  auto &list = grid[cell].worldSegments;
+  list.push_back(s);
+  packedDirty = true;
   return list.back();
 }
 
-void PhysicsManager::editor_UpdateSegmentList()
+void PhysicsManager::removeWorldSegments(const std::vector<Segment> &segments)
 {
-  for (int gridPos = 0; gridPos < (width/GRID_SIZE)*(height/GRID_SIZE); gridPos++) {
-    auto &list = grid[gridPos].worldSegments;
-    for (auto it = list.begin(); it != list.end();) {
-      Segment &s = *it;
-      int sx = s.getCenter()[0]/GRID_SIZE,
-	sy = s.getCenter()[1]/GRID_SIZE;
-      int seggrid = sx + sy*(width/GRID_SIZE);
-      if (seggrid != gridPos) {
-	addWorldSegment(s[0], s[1]);
-	it = list.erase(it);
-      } else ++it;
+  for (const Segment &s : segments) {
+    CellKey cell = getCell(s.getCenter());
+    GridBox *b = grid.find(cell);
+    if (b == nullptr) continue;
+    auto &list = b->worldSegments;
+    for (auto it = list.begin(); it != list.end(); ++it) {
+      if (it->getID() == s.getID()) { list.erase(it); break; }
     }
-  } 
+    if (list.empty() && b->entities.empty()) grid.erase(cell);
+  }
+  packedDirty = true;
+}
+
+void PhysicsManager::editor_RemoveSegment(Segment *s)
+{
+  // The editor drags points around without re-bucketing, so the segment may
+  // still be sitting in the cell it started in. Look everywhere for it
+  packedDirty = true;
+  bool found = false;
+  grid.forEach([this, s, &found](const CellKey &cell, GridBox &b) {
+      if (found) return;
+      for (auto it = b.worldSegments.begin(); it != b.worldSegments.end(); ++it) {
+	if (&(*it) != s) continue;
+	b.worldSegments.erase(it);
+	if (b.worldSegments.empty() && b.entities.empty()) grid.erase(cell);
+	found = true;
+	return;
+      } });
+}
+
+void PhysicsManager::editor_UpdateSegmentList()
+{
+  packedDirty = true;
+  std::vector<Segment> moved;
+  grid.forEach([&moved](const CellKey &cell, GridBox &b) {
+      for (auto it = b.worldSegments.begin(); it != b.worldSegments.end();) {
+	if (getCell(it->getCenter()) != cell) {
+	  moved.push_back(*it);
+	  it = b.worldSegments.erase(it);
+	} else ++it;
+      } });
+  for (const Segment &s : moved) addWorldSegment(s);
 }
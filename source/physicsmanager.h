@@ -6,8 +6,11 @@
 #include <list>
 #include <functional>
 #include <algorithm>
+#include <cmath>
 
 #include "segment.h"
+#include "cellmap.h"
+#include "segmentbvh.h"
 #include "boundingbox.h"
 #include "entity.h"
 
@@ -26,43 +29,80 @@ class PhysicsManager
 
   struct RayResult
   {
-    RayResult() : t(1.f), c(Vec2f(0,0)), d(Vec2f(0,0)), normal(Vec2f(0,0)), hit(false), corner(false) {}
+    RayResult() : t(1.f), c(Vec2f(0,0)), d(Vec2f(0,0)), normal(Vec2f(0,0)), hit(false), corner(false), segment(-1) {}
     float t;
     Vec2f c, d, normal;
     bool hit, corner;
+    int segment; // ID of the segment hit, -1 for corners and segments without one
   };
 
-  void resizeWorld( int w, int h ) {
-    width = w; height = h;
-    grid.resize( (w/GRID_SIZE)*(h/GRID_SIZE) );
-  }
+  // Cells only exist while something is in them, so the size of the world
+  // doesn't cost anything by itself. Things outside of it work just the same.
+  void resizeWorld( int w, int h ) { width = w; height = h; }
   int getWorldWidth() const { return width; }
   int getWorldHeight() const { return height; }
 
-  void clearWorld() { grid.clear(); }
+  void clearWorld() { grid.clear(); segmentCells = {{0, 0}, {-1, -1}}; packedDirty = true; }
+
+  Segment &addWorldSegment(const Vec2f &a, const Vec2f &b, int id = -1) { return addWorldSegment(Segment(a, b, id)); }
+  Segment &addWorldSegment(const Segment&);
+
+  // Takes out the segments with the same ids as these (i.e. a region of the
+  // scene that isn't needed anymore)
+  void removeWorldSegments(const std::vector<Segment>&);
 
-  Segment &addWorldSegment(const Vec2f &a, const Vec2f &b);
+  // How full the grid's table is, and roughly how much memory the grid takes
+  // (table, segments, BVH and entity lists)
+  int getCellCount() const { return grid.size(); }
+  int getCellCapacity() const { return grid.getCapacity(); }
+  size_t getGridMemory() const;
 
   void registerEntity(Entity* e) {
-    int gridPos = getGridPos(e->getPosition());
-    grid[gridPos].entities.push_back(e);
-    entityIndex[(unsigned long)e] = gridPos; }
+    CellKey cell = getCell(e->getPosition());
+    grid[cell].entities.push_back(e);
+    entityIndex[(unsigned long)e] = cell; }
 
   void unregisterEntity(Entity* e) {
     auto it = entityIndex.find((unsigned long)e);
-    grid[it->second].entities.remove(e);
+    GridBox *b = grid.find(it->second);
+    if (b != nullptr) b->entities.remove(e);
     entityIndex.erase(it); }
 
-  // Calls a funcrion for every segment in the specified range on the world grid.
-  void querySegmentGridArea( const Vec2f &position, int range, std::function<void(const Segment&)> &&f ) {
-    queryGridRange(position, range, [&](GridBox& b) {
-	std::for_each(b.worldSegments.begin(), b.worldSegments.end(), f); }); }
+  // The segments of one grid cell, next to each other in memory
+  struct SegmentSpan
+  {
+    const Segment *first, *last;
+    const Segment *begin() const { return first; }
+    const Segment *end() const { return last; }
+  };
+  SegmentSpan getCellSegments(const CellKey &cell) {
+    if (packedDirty) packSegments();
+    const GridBox *b = grid.find(cell);
+    if (b == nullptr) return { nullptr, nullptr };
+    return { packedSegments.data() + b->packedFirst, packedSegments.data() + b->packedLast }; }
+
+  // The queries take any callable as a template parameter instead of a
+  // std::function, so the callbacks in the collision loops can be inlined.
+
+  // Calls a function for every segment in the specified range on the world grid.
+  template <typename F>
+  void querySegmentGridArea( const Vec2f &position, int range, F &&f ) {
+    queryGridRange(position, range, [&](const CellKey &cell) {
+	for (const Segment &s : getCellSegments(cell)) f(s); }); }
+
+  // Calls a function for every segment in the world
+  template <typename F>
+  void queryAllSegments( F &&f ) const {
+    grid.forEach([&f](const CellKey&, const GridBox &b) { std::for_each(b.worldSegments.begin(), b.worldSegments.end(), f); }); }
 
   // Places entities in the right grid for queries
   void updateEntityList();
-  void queryEntityGridArea( const Vec2f &position, int range, int mask, std::function<void(Entity*)> &&f ) {
-    queryGridRange(position, range, [&](GridBox& b) {
-	for (Entity *e : b.entities) { if (e->isAlive() && e->getMask()&mask) f(e); } }); }
+  template <typename F>
+  void queryEntityGridArea( const Vec2f &position, int range, int mask, F &&f ) {
+    queryGridRange(position, range, [&](const CellKey &cell) {
+	const GridBox *b = grid.find(cell);
+	if (b == nullptr) return;
+	for (Entity *e : b->entities) { if (e->isAlive() && e->getMask()&mask) f(e); } }); }
 
   // remove stuff
   // void clearScene();
@@ -76,10 +116,39 @@ class PhysicsManager
   // Casts a ray. Resulting vector is the new position and normal of hit.
   RayResult rayCast(int mask, const Vec2f& a, const Vec2f& b);
 
+  // Casts many short rays (from a in the direction d) in one go. The rays are
+  // bucketed by grid cell so the segments around a cell are only gathered once
+  // for every ray starting in it (rays longer than half a cell are cast on their
+  // own). Writes the hit fraction (1 if nothing was hit) and hit normal of every ray.
+  void rayCastBatch(int mask, int count, const float *ax, const float *ay, const float *dx, const float *dy,
+		    float *t, float *nx, float *ny);
+
+  // True if nothing in the world blocks the line between a and b. Stops at
+  // the first blocking segment, and works for lines of any length.
+  bool lineOfSight(const Vec2f &a, const Vec2f &b);
+
   // Casts "planes" originating between the specified points
-  // Used for bounding box collision
+  // Used for bounding box collision. Checks everything the box sweeps over,
+  // so a box can't pass through a thin segment however far it moves at once.
   RayResult multiPlaneCast(int mask, const Vec2f &dir, const std::vector<Vec2f> &points);
 
+  // The world segment with this ID, or nullptr if it isn't loaded. Good until
+  // the segments change.
+  const Segment *getSegment(int id) {
+    if (packedDirty) packSegments();
+    return id >= 0 && id < static_cast<int>(segmentByID.size()) && segmentByID[id] >= 0 ?
+      &packedSegments[segmentByID[id]] : nullptr; }
+
+  // The world segment closest to the position within maxDist, or nullptr.
+  // The closest point on it goes in closest, if given.
+  const Segment *nearestSegment(const Vec2f &position, float maxDist, Vec2f *closest = nullptr);
+
+  // rayCast, lineOfSight and multiPlaneCast search the segment BVH (rebuilt
+  // on the first query after the segments change). Turning it off walks the
+  // grid cells instead, which is only there to compare against.
+  void setUseBVH(bool b) { useBVH = b; }
+  int getBVHNodeCount() const { return bvh.getNodeCount(); }
+
   // Generic collision tests
   static bool boxIntersection( const Vec2f &box1c, const Vec2f &box1h,
 			       const Vec2f &box2c, const Vec2f &box2h );
@@ -89,6 +158,12 @@ class PhysicsManager
 
   static bool boxCircleIntersection( const BoundingBox&, const Vec2f &cpos, float crad);
 
+  // Separating axis test of a circle against a convex polygon placed at
+  // offset. The normals are the polygon's outward edge normals (edge i runs
+  // from vertex i to i+1).
+  static bool convexCircleIntersection( const Vec2f *verts, const Vec2f *normals, unsigned count,
+					const Vec2f &offset, const Vec2f &cpos, float crad );
+
   // Generic collision calculations
   static Vec2f rayStop( const Vec2f &direction, const Vec2f &normal, float distFactor );
   static Vec2f raySlide( const Vec2f &direction, const Vec2f &normal, float distFactor );
@@ -97,12 +172,11 @@ class PhysicsManager
   PhysicsManager &operator=(const PhysicsManager&) = delete;
 
   // Only the level editor should use this
-  void editor_QueryAllSegments(std::function<void(Segment&s)> &&f) {
-    for (auto &b : grid) std::for_each(b.worldSegments.begin(), b.worldSegments.end(), f); }
-  void editor_RemoveSegment(Segment *s) {
-    for (auto &b : grid) {
-      for (auto it = b.worldSegments.begin(); it != b.worldSegments.end(); ++it) {
-	if (&(*it) == s) { it = b.worldSegments.erase(it); return; } } } }
+  template <typename F>
+  void editor_QueryAllSegments(F &&f) {
+    packedDirty = true;
+    grid.forEach([&f](const CellKey&, GridBox &b) { std::for_each(b.worldSegments.begin(), b.worldSegments.end(), f); }); }
+  void editor_RemoveSegment(Segment *s);
   void editor_UpdateSegmentList();
   
  private:
@@ -114,40 +188,69 @@ class PhysicsManager
   // World dimensions
   int width, height;
 
-  // Collision segments of the background
+  // Collision segments of the background. The lists own them (the editor
+  // holds on to pointers), and the queries read packed copies.
   struct GridBox
   {
-  GridBox() : worldSegments(), entities() {}
+  GridBox() : worldSegments(), entities(), packedFirst(0), packedLast(0), walkStamp(0) {}
     std::list<Segment> worldSegments;
     std::list<Entity*> entities;
+
+    // Where the cell's segments are in packedSegments
+    int packedFirst, packedLast;
+
+    // Which walkSegments call last looked at the cell
+    unsigned walkStamp;
   };
-  
-  std::vector< GridBox > grid;
-  std::unordered_map<unsigned long, int> entityIndex;
 
-  int getGridPos( const Vec2f &position ) {
-    int x = position[0]/GRID_SIZE, y = position[1]/GRID_SIZE;
-    return x + y * (width/GRID_SIZE);
-  }
+  // Only the cells with something in them
+  CellMap< GridBox > grid;
+  std::unordered_map<unsigned long, CellKey> entityIndex;
 
-  std::list<Segment> &getSegmentList(const Vec2f &position) {
-    return grid[ getGridPos(position) ].worldSegments;
-  }
+  // The corners of the cells that have ever had segments in them (since the
+  // last clear), so walkSegments doesn't wander through empty space
+  struct CellRange { CellKey min, max; } segmentCells;
+
+  // Every cell's segments in one array, cell by cell, and the BVH over them.
+  // Rebuilt on the next query after the segments change.
+  std::vector< Segment > packedSegments;
+  std::vector< int > segmentByID; // Into packedSegments, -1 if not loaded
+  SegmentBVH bvh;
+  bool packedDirty, useBVH;
+  void packSegments();
+
+  // Scratch space for rayCastBatch
+  std::vector< std::pair<CellKey,int> > batchOrder; // cell, ray index
+  std::vector< const Segment* > batchSegments;
 
-  void queryGridRange( const Vec2f &position, int range, std::function<void(GridBox&)> &&function ) {
-    int xmin = position[0]/GRID_SIZE - range,
-    ymin = position[1]/GRID_SIZE - range,
-    xmax = xmin+range*2,
-    ymax = ymin+range*2;
+  // Stamped on cells walkSegments visits, so they aren't visited twice
+  unsigned walkQuery;
 
-    xmin = std::max(xmin, 0);
-    ymin = std::max(ymin, 0);
-    xmax = std::min(xmax, (width/GRID_SIZE)-1);
-    ymax = std::min(ymax, (height/GRID_SIZE)-1);
+  // Calls f for every segment the line from a to b might hit (from the BVH,
+  // or the segments around every grid cell the line passes through). Stops
+  // and returns true as soon as f does. The BVH also skips whatever is
+  // farther along than *maxT (see SegmentBVH::queryRay).
+  template <typename F>
+  bool walkSegments(const Vec2f &a, const Vec2f &b, F &&f, const float *maxT = nullptr);
+
+  int statIntersections;
+
+  // Rounds down (so -1 is in cell -1, not 0), and keeps far off or broken
+  // positions from overflowing
+  static int cellCoord( float v ) {
+    float c = std::floor(v / GRID_SIZE);
+    if (!(c > -1e9f)) return -1000000000;
+    return c < 1e9f ? static_cast<int>(c) : 1000000000;
+  }
+  static CellKey getCell( const Vec2f &position ) { return { cellCoord(position[0]), cellCoord(position[1]) }; }
 
-    for (int x = xmin; x <= xmax; x++) {
-      for (int y = ymin; y <= ymax; y++) {
-	function(grid[x + y * (width/GRID_SIZE)]);
+  // Calls a function with every cell in range (whether it exists or not)
+  template <typename F>
+  void queryGridRange( const Vec2f &position, int range, F &&function ) {
+    CellKey c = getCell(position);
+    for (int x = c.x - range; x <= c.x + range; x++) {
+      for (int y = c.y - range; y <= c.y + range; y++) {
+	function(CellKey{x, y});
       }
     }
   }
@@ -0,0 +1,24 @@
+#include "random.h"
+
+#include <chrono>
+
+Random &Random::getInstance()
+{
+  static Random instance;
+  return instance;
+}
+
+// Seeded from the clock until someone (like a replay) picks a seed
+Random::Random() : state(0), seedValue(0)
+{
+  seed(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+}
+
+void Random::seed(uint64_t s)
+{
+  seedValue = s;
+  state = 0;
+  next();
+  state += s;
+  next();
+}
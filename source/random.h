@@ -0,0 +1,48 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+
+/*
+ * The one random number generator everything in the game uses, so a whole
+ * session can be played again exactly from its seed (see Replay). It's a
+ * PCG32: small, fast, and the same numbers on every platform, unlike rand()
+ * and drand48().
+ */
+class Random
+{
+ public:
+  static Random &getInstance();
+
+  void seed(uint64_t s);
+  uint64_t getSeed() const { return seedValue; }
+
+  // For snapshots, which pick up exactly where the numbers left off
+  uint64_t getState() const { return state; }
+  void restore(uint64_t s, uint64_t st) { seedValue = s; state = st; }
+
+  uint32_t next() {
+    uint64_t old = state;
+    state = old * 6364136223846793005ULL + INCREMENT;
+    uint32_t shifted = ((old >> 18u) ^ old) >> 27u;
+    uint32_t rot = old >> 59u;
+    return (shifted >> rot) | (shifted << ((-rot) & 31));
+  }
+
+  // From 0 up to (not including) 1
+  float real() { return (next() >> 8) * (1.f / 16777216.f); }
+
+  // From 0 up to (not including) n
+  int range(int n) { return n > 0 ? static_cast<int>((static_cast<uint64_t>(next()) * n) >> 32) : 0; }
+
+  Random(const Random&) = delete;
+  Random &operator=(const Random&) = delete;
+
+ private:
+  Random();
+
+  static const uint64_t INCREMENT = 1442695040888963407ULL;
+  uint64_t state, seedValue;
+};
+
+#endif
@@ -4,6 +4,8 @@
 #include <string>
 #include <SDL.h>
 
+bool RenderContext::headless = false;
+
 RenderContext::RenderContext() :
   window(nullptr),
   renderer(nullptr)
@@ -28,16 +30,16 @@ RenderContext& RenderContext::getInstance() {
 
 SDL_Window* RenderContext::initWindow( ) {
 
-  GameConfig &cfg = GameConfig::getInstance();
+  const Settings &cfg = GameConfig::getInstance().get();
   
-  std::string title = cfg["title"].toStr();
-  int width  = cfg["view"]["width"].toInt();
-  int height = cfg["view"]["height"].toInt();
+  std::string title = cfg.title;
+  int width  = cfg.view.width;
+  int height = cfg.view.height;
   
   window = SDL_CreateWindow( title.c_str(), SDL_WINDOWPOS_CENTERED, 
-    SDL_WINDOWPOS_CENTERED, width, height, SDL_WINDOW_SHOWN );
+    SDL_WINDOWPOS_CENTERED, width, height, headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN );
 
-  if (cfg["view"]["fullscreen"].toBool())
+  if (cfg.view.fullscreen && !headless)
     SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN);
 	
   if( window == nullptr ) {
@@ -50,7 +52,8 @@ SDL_Window* RenderContext::initWindow( ) {
 SDL_Renderer* RenderContext::initRenderer() {
   // To test the Clock class's ability to cap the frame rate, use:
   SDL_Renderer* renderer =
-    GameConfig::getInstance()["vsync"].toBool() ?
+    headless ? SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE) :
+    GameConfig::getInstance().get().vsync ?
     SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC) :
     SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
     //SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE );
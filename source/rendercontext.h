@@ -11,10 +11,16 @@ public:
   SDL_Window* getWindow() const { return window; }
   SDL_Renderer* getRenderer() const { return renderer; }
 
+  // A hidden window with a software renderer, for running without a screen.
+  // Has to be set before the first getInstance.
+  static void setHeadless(bool h) { headless = h; }
+  static bool isHeadless() { return headless; }
+
   RenderContext(const RenderContext&) = delete;
   RenderContext& operator=(const RenderContext&) = delete;
 
 private:
+  static bool headless;
   SDL_Window* window;
   SDL_Renderer* renderer;
 
@@ -0,0 +1,42 @@
+#include "replay.h"
+#include "binaryio.h"
+
+void Replay::endFrame(float delta)
+{
+  frames.emplace_back();
+  frames.back().delta = delta;
+  frames.back().keys.swap(pending);
+}
+
+void Replay::save(const std::string &file) const
+{
+  BinaryWriter out(file, "RPL1");
+  out.put(seed, 8);
+  out.put(frames.size(), 4);
+  for (const Frame &f : frames) {
+    out.putFloat(f.delta);
+    out.put(f.keys.size(), 2);
+    for (const Key &k : f.keys) {
+      out.put(k.scancode, 2);
+      out.put(k.down, 1);
+      out.put(k.repeat, 1);
+    }
+  }
+}
+
+void Replay::load(const std::string &file)
+{
+  BinaryReader in(file, "RPL1");
+  seed = in.get(8);
+  frames.resize(in.get(4));
+  for (Frame &f : frames) {
+    f.delta = in.getFloat();
+    f.keys.resize(in.get(2));
+    for (Key &k : f.keys) {
+      k.scancode = in.get(2);
+      k.down = in.get(1);
+      k.repeat = in.get(1);
+    }
+  }
+  pending.clear();
+}
@@ -0,0 +1,59 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/*
+ * A recorded play session: the random seed it started with, and for every
+ * frame how long it was and which keys went up or down during it. Playing the
+ * keys back with the same seed and frame times runs the exact same game,
+ * which makes it good for comparing how fast different builds get through
+ * the same fight.
+ *
+ * File layout, little-endian:
+ *   char[4] "RPL1"
+ *   u64     seed
+ *   u32     frame count
+ *   frames:
+ *     f32   delta (seconds)
+ *     u16   key count
+ *     keys: u16 scancode, u8 down, u8 repeat
+ */
+class Replay
+{
+ public:
+  struct Key
+  {
+    int scancode;
+    bool down, repeat;
+  };
+
+  struct Frame
+  {
+    Frame() : delta(0.f), keys() {}
+    float delta;
+    std::vector<Key> keys;
+  };
+
+  Replay() : seed(0), frames(), pending() {}
+
+  // Recording. Keys go into the frame that ends next.
+  void begin(uint64_t s) { seed = s; frames.clear(); pending.clear(); }
+  void addKey(int scancode, bool down, bool repeat) { pending.push_back({scancode, down, repeat}); }
+  void endFrame(float delta);
+
+  void save(const std::string &file) const;
+  void load(const std::string &file);
+
+  uint64_t getSeed() const { return seed; }
+  const std::vector<Frame> &getFrames() const { return frames; }
+
+ private:
+  uint64_t seed;
+  std::vector<Frame> frames;
+  std::vector<Key> pending;
+};
+
+#endif
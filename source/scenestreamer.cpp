@@ -0,0 +1,618 @@
+#include "scenestreamer.h"
+#include "binaryio.h"
+#include "physicsmanager.h"
+#include "canvas.h"
+#include "imagefactory.h"
+#include "eventmanager.h"
+#include "gamemanager.h"
+#include "gameconfig.h"
+#include "gamesnapshot.h"
+#include "navgraph.h"
+#include "segmentweld.h"
+#include "xmlparser.h"
+
+#include "entity/actor.h"
+
+#include <sys/stat.h>
+#include <cstdio>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <unordered_set>
+#include <iostream>
+
+namespace {
+
+// When the file was last changed, or 0 if it isn't there
+time_t modified(const std::string &file)
+{
+  struct stat s;
+  return stat(file.c_str(), &s) == 0 ? s.st_mtime : 0;
+}
+
+const char MAGIC[] = "SCN2";
+
+// Whether the file was compiled with the collision settings in use now
+bool sameCollision(const std::string &scn)
+{
+  try {
+    BinaryReader in(scn, MAGIC);
+    const Settings::Collision &c = GameConfig::getInstance().get().collision;
+    float weldDist = in.getFloat(), mergeDist = in.getFloat(), maxLength = in.getFloat();
+    return weldDist == c.weldDist && mergeDist == c.mergeDist && maxLength == c.maxLength;
+  }
+  catch (const std::string&) {
+    return false; // From before the settings went in, or not there at all
+  }
+}
+
+int regionAt(const Vec2f &position, int size, int cols, int rows)
+{
+  int x = std::min(std::max(static_cast<int>(std::floor(position[0]/size)), 0), cols-1);
+  int y = std::min(std::max(static_cast<int>(std::floor(position[1]/size)), 0), rows-1);
+  return x + y*cols;
+}
+
+}
+
+SceneStreamer &SceneStreamer::getInstance()
+{
+  static SceneStreamer instance;
+  return instance;
+}
+
+SceneStreamer::SceneStreamer() :
+  file(), regionSize(REGION_SIZE), cols(0), rows(0), regions(), loaded(), images(), spawns(), pending(0),
+  synchronous(false),
+  loader(), loadMutex(), loadSignal(), requests(), results(), stopLoading(false), generation(0)
+{
+  loader = std::thread(&SceneStreamer::loadThread, this);
+}
+
+SceneStreamer::~SceneStreamer()
+{
+  {
+    std::lock_guard<std::mutex> lock(loadMutex);
+    stopLoading = true;
+  }
+  loadSignal.notify_all();
+  loader.join();
+}
+
+void SceneStreamer::open(const std::string &scene)
+{
+  close();
+
+  std::string xml = "assets/scenes/" + scene + ".xml", scn = "assets/scenes/" + scene + ".scn";
+  time_t scnTime = modified(scn);
+  if (scnTime == 0 || scnTime < modified(xml) || !sameCollision(scn)) compile(xml, scn);
+
+  BinaryReader in(scn, MAGIC);
+  for (int i = 0; i < 3; i++) in.getFloat();
+  int width = in.get(4), height = in.get(4);
+  regionSize = in.get(4);
+  cols = in.get(4);
+  rows = in.get(4);
+  PhysicsManager::getInstance().resizeWorld(width, height);
+
+  EventManager &eventmgr = EventManager::getInstance();
+  for (int i = in.get(2); i > 0; i--) {
+    std::string name = in.getString();
+    Vec2f position = in.getVec();
+    eventmgr.createEntryPoint(name, position, in.get(1) ? Animation::DIR_LEFT : Animation::DIR_RIGHT);
+  }
+
+  Canvas &canvas = Canvas::getInstance();
+  for (int i = in.get(2); i > 0; i--) {
+    int id = in.getInt(4);
+    canvas.setScrollFactor( id, in.getFloat() );
+    std::string background = in.getString();
+    canvas.setBackground( id, background.empty() ? nullptr : ImageFactory::getInstance().getImage(background) );
+    canvas.setBackgroundAlpha( id, in.getFloat() );
+  }
+
+  images.resize(in.get(2));
+  for (std::string &image : images) image = in.getString();
+
+  spawns.resize(in.get(4));
+  for (Spawn &s : spawns) {
+    s.model = in.getString();
+    s.position = in.getVec();
+  }
+
+  regions.resize(cols*rows);
+  for (unsigned i = 0; i < regions.size(); i++) {
+    Region &r = regions[i];
+    r.offset = in.get(8);
+    r.bytes = in.get(4);
+    r.firstSegment = in.get(4);
+    r.segmentCount = in.get(4);
+    r.firstSpawn = in.get(4);
+    r.spawnCount = in.get(4);
+    r.backdropCount = in.get(4);
+    for (int s = r.firstSpawn; s < r.firstSpawn + r.spawnCount; s++) spawns.at(s).region = i;
+  }
+  file = scn;
+
+  // The nav graph is built from (or checked against) every segment, so they
+  // all go in for that and straight back out. Backdrops and images don't need
+  // to be touched; regions get loaded for real as the view comes near them.
+  std::vector<Segment> segments;
+  for (const Region &r : regions) readSegments(in, r, segments);
+  PhysicsManager &physics = PhysicsManager::getInstance();
+  for (const Segment &s : segments) physics.addWorldSegment(s);
+  NavGraph::getInstance().build(scene);
+  physics.removeWorldSegments(segments);
+}
+
+void SceneStreamer::close()
+{
+  // The segments, backdrops and enemies themselves get cleared by GameManager::clearScene
+  {
+    std::lock_guard<std::mutex> lock(loadMutex);
+    requests.clear();
+    results.clear();
+    generation++;
+  }
+  file.clear();
+  regions.clear();
+  loaded.clear();
+  images.clear();
+  spawns.clear();
+  pending = 0;
+  cols = rows = 0;
+}
+
+void SceneStreamer::update(const Vec2f &a, const Vec2f &b)
+{
+  if (!isOpen()) return;
+  const Settings::Streaming &settings = GameConfig::getInstance().get().streaming;
+  float loadDist = settings.loadDist, unloadDist = std::max(settings.loadDist, settings.unloadDist);
+
+  // Put in whatever the loading thread finished. Ones that came in some other
+  // way while they were loading are already in.
+  std::deque<RegionData> done;
+  {
+    std::lock_guard<std::mutex> lock(loadMutex);
+    done.swap(results);
+  }
+  for (RegionData &data : done) {
+    Region &r = regions[data.region];
+    if (data.generation != generation || r.state != REGION_PENDING) continue;
+    if (data.error.empty()) install(data);
+    else fail(data.region, data.error);
+  }
+
+  forEachNear(a, loadDist, [this](int region) { request(region); });
+  forEachNear(b, loadDist, [this](int region) { request(region); });
+
+  for (auto it = loaded.begin(); it != loaded.end();) {
+    if (distanceTo(*it, a) > unloadDist && distanceTo(*it, b) > unloadDist) {
+      uninstall(*it);
+      it = loaded.erase(it);
+    } else ++it;
+  }
+
+  updateSpawns();
+}
+
+void SceneStreamer::loadAround(const Vec2f &position)
+{
+  if (!isOpen()) return;
+
+  BinaryReader in(file, MAGIC);
+  forEachNear(position, GameConfig::getInstance().get().streaming.loadDist, [this, &in](int region) {
+      if (regions[region].state == REGION_LOADED) return;
+      RegionData data;
+      data.region = region;
+      readRegion(in, regions[region], data);
+      install(data);
+    });
+}
+
+int SceneStreamer::getEnemiesLeft() const
+{
+  return std::count_if(spawns.begin(), spawns.end(), [](const Spawn &s) { return s.state != Spawn::DEAD; });
+}
+
+void SceneStreamer::saveSpawns(std::vector<int> &out, const EntityIDs &ids) const
+{
+  out.resize(spawns.size());
+  for (unsigned i = 0; i < spawns.size(); i++) {
+    const Spawn &s = spawns[i];
+    if (s.state == Spawn::WAITING) out[i] = -1;
+    else if (s.state == Spawn::DEAD) out[i] = -2;
+    else {
+      // Not in the snapshot means it's already dying
+      int id = ids.find(s.actor);
+      out[i] = id >= 0 ? id : -2;
+    }
+  }
+}
+
+void SceneStreamer::restoreSpawns(const std::vector<int> &in, const EntityIDs &ids)
+{
+  if (in.size() != spawns.size())
+    throw std::string("The snapshot's enemies don't match " + file);
+
+  for (unsigned i = 0; i < spawns.size(); i++) {
+    Spawn &s = spawns[i];
+    s.actor = in[i] >= 0 ? static_cast<Actor*>(ids.get(in[i])) : nullptr;
+    if (s.actor != nullptr) s.state = Spawn::ALIVE;
+    else s.state = in[i] == -2 ? Spawn::DEAD : Spawn::WAITING;
+  }
+}
+
+int SceneStreamer::regionAt(const Vec2f &position) const
+{
+  return ::regionAt(position, regionSize, cols, rows);
+}
+
+float SceneStreamer::distanceTo(int region, const Vec2f &position) const
+{
+  float left = (region % cols) * regionSize, top = (region / cols) * regionSize;
+  Vec2f nearest( std::min(std::max(position[0], left), left + regionSize),
+		 std::min(std::max(position[1], top), top + regionSize) );
+  return (position - nearest).length();
+}
+
+template <typename F>
+void SceneStreamer::forEachNear(const Vec2f &position, float dist, F &&f) const
+{
+  // Only the regions the circle's box covers, so it doesn't matter how many there are
+  int x0 = std::max(static_cast<int>(std::floor((position[0]-dist)/regionSize)), 0),
+    x1 = std::min(static_cast<int>(std::floor((position[0]+dist)/regionSize)), cols-1),
+    y0 = std::max(static_cast<int>(std::floor((position[1]-dist)/regionSize)), 0),
+    y1 = std::min(static_cast<int>(std::floor((position[1]+dist)/regionSize)), rows-1);
+
+  for (int y = y0; y <= y1; y++)
+    for (int x = x0; x <= x1; x++)
+      if (distanceTo(x + y*cols, position) <= dist) f(x + y*cols);
+}
+
+void SceneStreamer::request(int region)
+{
+  Region &r = regions[region];
+  if (r.state != REGION_UNLOADED) return;
+
+  if (synchronous) {
+    RegionData data;
+    data.region = region;
+    try {
+      BinaryReader in(file, MAGIC);
+      readRegion(in, r, data);
+    }
+    catch (const std::string &msg) {
+      fail(region, msg);
+      return;
+    }
+    install(data);
+    return;
+  }
+
+  r.state = REGION_PENDING;
+  pending++;
+  {
+    std::lock_guard<std::mutex> lock(loadMutex);
+    requests.push_back({file, region, generation, r});
+  }
+  loadSignal.notify_one();
+}
+
+void SceneStreamer::install(RegionData &data)
+{
+  Region &r = regions[data.region];
+
+  PhysicsManager &physics = PhysicsManager::getInstance();
+  for (const Segment &s : data.segments) physics.addWorldSegment(s);
+  r.segments.swap(data.segments);
+
+  // Images only get loaded the first time a region needs them
+  Canvas &canvas = Canvas::getInstance();
+  for (const RegionData::BackdropData &b : data.backdrops) {
+    const Image *image = b.image >= 0 ? ImageFactory::getInstance().getImage(images.at(b.image)) : nullptr;
+    r.backdrops.emplace_back(b.layer, canvas.placeBackdrop( b.layer, b.order, image, b.position, b.frame,
+							    b.angle, b.scaleX, b.scaleY, b.flipH, b.flipV ));
+  }
+
+  if (r.state == REGION_PENDING) pending--;
+  r.state = REGION_LOADED;
+  loaded.push_back(data.region);
+}
+
+void SceneStreamer::fail(int region, const std::string &error)
+{
+  std::cout << "SceneStreamer: couldn't load region " << region << ": " << error << std::endl;
+  Region &r = regions[region];
+  if (r.state == REGION_PENDING) pending--;
+  r.state = REGION_FAILED;
+}
+
+void SceneStreamer::uninstall(int region)
+{
+  Region &r = regions[region];
+  PhysicsManager::getInstance().removeWorldSegments(r.segments);
+
+  std::map<int, std::unordered_set<const Backdrop*> > byLayer;
+  for (const auto &b : r.backdrops) byLayer[b.first].insert(b.second);
+  for (const auto &l : byLayer) Canvas::getInstance().removeBackdrops(l.first, l.second);
+
+  // Swapped out rather than cleared, so the memory actually goes
+  std::vector<Segment>().swap(r.segments);
+  std::vector< std::pair<int, const Backdrop*> >().swap(r.backdrops);
+  r.state = REGION_UNLOADED;
+}
+
+void SceneStreamer::updateSpawns()
+{
+  GameManager &gamemgr = GameManager::getInstance();
+
+  // Let go of every dead or stranded actor first. Spawning reuses pooled actors, so
+  // checking a later spawn after an earlier one respawned could see its own actor
+  // handed to someone else and look alive
+  for (Spawn &s : spawns) {
+    if (s.state != Spawn::ALIVE) continue;
+    if (!s.actor->isAlive()) {
+      s.state = Spawn::DEAD;
+      s.actor = nullptr;
+    }
+    // Wandered off (or got left behind) where there's no ground anymore
+    else if (regions[regionAt(s.actor->getPosition())].state != REGION_LOADED) {
+      gamemgr.despawnActor(s.actor);
+      s.state = Spawn::WAITING;
+      s.actor = nullptr;
+    }
+  }
+
+  for (Spawn &s : spawns) {
+    // Never going to show up, and the level still has to be winnable
+    if (s.state == Spawn::WAITING && regions[s.region].state == REGION_FAILED) s.state = Spawn::DEAD;
+    if (s.state == Spawn::WAITING && regions[s.region].state == REGION_LOADED) {
+      // TO-DO: spawns don't have a direction yet
+      s.actor = gamemgr.spawnEnemy(s.model, s.position, Animation::DIR_RIGHT);
+      s.state = Spawn::ALIVE;
+    }
+  }
+}
+
+void SceneStreamer::readSegments(BinaryReader &in, const Region &info, std::vector<Segment> &segments)
+{
+  in.seek(info.offset);
+
+  segments.reserve(segments.size() + info.segmentCount);
+  for (int i = 0; i < info.segmentCount; i++) {
+    Vec2f a = in.getVec(), b = in.getVec();
+    int prev = in.getInt(4);
+    segments.emplace_back(a, b, info.firstSegment + i, prev, in.getInt(4));
+  }
+}
+
+void SceneStreamer::readRegion(BinaryReader &in, const Region &info, RegionData &data)
+{
+  // Backdrops come right after the segments
+  readSegments(in, info, data.segments);
+
+  data.backdrops.resize(info.backdropCount);
+  for (RegionData::BackdropData &b : data.backdrops) {
+    b.layer = in.getInt(4);
+    b.order = in.get(4);
+    b.image = in.getInt(2);
+    b.position = in.getVec();
+    b.frame = in.getInt(4);
+    b.angle = in.getFloat();
+    b.scaleX = in.getFloat();
+    b.scaleY = in.getFloat();
+    b.flipH = in.get(1);
+    b.flipV = in.get(1);
+  }
+}
+
+void SceneStreamer::loadThread()
+{
+  while (true) {
+    Request request{};
+    {
+      std::unique_lock<std::mutex> lock(loadMutex);
+      loadSignal.wait(lock, [this]() { return stopLoading || !requests.empty(); });
+      if (stopLoading) return;
+      request = requests.front();
+      requests.pop_front();
+    }
+
+    RegionData data;
+    data.region = request.region;
+    data.generation = request.generation;
+    try {
+      BinaryReader in(request.file, MAGIC);
+      readRegion(in, request.info, data);
+    }
+    catch (const std::string &msg) {
+      // Handed back anyway, so the main thread can say so and give up on it
+      data.segments.clear();
+      data.backdrops.clear();
+      data.error = msg;
+    }
+
+    std::lock_guard<std::mutex> lock(loadMutex);
+    results.push_back(std::move(data));
+  }
+}
+
+void SceneStreamer::compile(const std::string &xml, const std::string &scn)
+{
+  // Written next to it and moved into place, so a crash or a full disk partway
+  // through can't leave a cut off file that looks newer than the XML
+  std::string tmp = scn + ".tmp";
+  try {
+    compileTo(xml, tmp);
+  }
+  catch (const std::string&) {
+    std::remove(tmp.c_str());
+    throw;
+  }
+  if (std::rename(tmp.c_str(), scn.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    throw std::string("Couldn't replace " + scn);
+  }
+}
+
+void SceneStreamer::compileTo(const std::string &xml, const std::string &file)
+{
+  XMLParser parser(xml);
+  const XMLTag &scene = parser.getTag("scene");
+  int width = scene["width"].toInt(), height = scene["height"].toInt();
+  int cols = std::max(1, (width + REGION_SIZE-1) / REGION_SIZE), rows = std::max(1, (height + REGION_SIZE-1) / REGION_SIZE);
+
+  struct Compiled
+  {
+    Compiled() : segments(), backdrops(), spawns() {}
+    std::vector<int> segments; // Into welded
+    std::vector<RegionData::BackdropData> backdrops;
+    std::vector< std::pair<std::string, Vec2f> > spawns;
+  };
+  std::vector<Compiled> compiled(cols*rows);
+  auto regionOf = [=](const Vec2f &position) { return ::regionAt(position, REGION_SIZE, cols, rows); };
+
+  if (scene.hasChild("enemies")) {
+    for (const XMLTag *e : scene["enemies"].getChildren())
+      compiled[regionOf(e->toVec2f())].spawns.emplace_back(e->getName(), e->toVec2f());
+  }
+
+  std::vector<Segment> welded;
+  for (const XMLTag *s : scene["collision"].getChildren())
+    welded.emplace_back( Vec2f((*s)["ax"].toFloat(), (*s)["ay"].toFloat()), Vec2f((*s)["bx"].toFloat(), (*s)["by"].toFloat()) );
+  const Settings::Collision &collision = GameConfig::getInstance().get().collision;
+  SegmentWeld::Result weld = SegmentWeld::run(welded, collision.weldDist, collision.mergeDist, collision.maxLength);
+  for (unsigned i = 0; i < welded.size(); i++) compiled[regionOf(welded[i].getCenter())].segments.push_back(i);
+
+  BinaryWriter out(file, MAGIC);
+  out.putFloat(collision.weldDist);
+  out.putFloat(collision.mergeDist);
+  out.putFloat(collision.maxLength);
+  out.put(width, 4);
+  out.put(height, 4);
+  out.put(REGION_SIZE, 4);
+  out.put(cols, 4);
+  out.put(rows, 4);
+
+  std::vector<const XMLTag*> entries;
+  for (const XMLTag *e : scene.getChildren())
+    if (e->getName() == "entry") entries.push_back(e);
+  out.put(entries.size(), 2);
+  for (const XMLTag *e : entries) {
+    out.putString((*e)["name"].toStr());
+    out.putVec(e->toVec2f());
+    out.put((*e)["dir"].toStr() == "left", 1);
+  }
+
+  // Backdrops go in the region they show up in, which for parallax layers is
+  // where the view is when they're on screen rather than where they are
+  const std::vector<XMLTag*> &layers = scene["canvas"].getChildren();
+  std::vector<std::string> images;
+  std::map<std::string, int> imageIDs;
+  out.put(layers.size(), 2);
+  for (const XMLTag *pl : layers) {
+    const XMLTag &l = *pl;
+    int layer = l["id"].toInt();
+    float scroll = l.hasChild("scroll") ? l["scroll"].toFloat() : 1.f;
+    out.put(layer, 4);
+    out.putFloat(scroll);
+    out.putString(l.hasChild("background") ? l["background"].toStr() : "");
+    out.putFloat(l.hasChild("bgAlpha") ? l["bgAlpha"].toFloat() : 1.f);
+
+    std::map<int, int> sets;
+    int order = 0;
+    for (const XMLTag *po : l.getChildren()) {
+      const XMLTag &o = *po;
+      if (o.getName() == "backdropSet") {
+	auto it = imageIDs.insert(std::make_pair(o["image"].toStr(), images.size()));
+	if (it.second) images.push_back(o["image"].toStr());
+	sets[o["id"].toInt()] = it.first->second;
+      }
+      else if (o.getName() == "bd") {
+	auto set = sets.find(o["set"].toInt());
+	RegionData::BackdropData b = {
+	  layer, order++, set == sets.end() ? -1 : set->second, o.toVec2f(), o["frame"].toInt(),
+	  o.hasChild("angle") ? o["angle"].toFloat() : 0.f,
+	  o.hasChild("scaleX") ? o["scaleX"].toFloat() : 1.f,
+	  o.hasChild("scaleY") ? o["scaleY"].toFloat() : 1.f,
+	  o.hasChild("flipH") ? o["flipH"].toBool() : false,
+	  o.hasChild("flipV") ? o["flipV"].toBool() : false };
+	compiled[regionOf(scroll > 0.f ? b.position/scroll : b.position)].backdrops.push_back(b);
+      }
+    }
+  }
+
+  out.put(images.size(), 2);
+  for (const std::string &image : images) out.putString(image);
+
+  // Segments get numbered region by region, and their links go by number
+  std::vector<Region> table(compiled.size());
+  std::vector<int> ids(welded.size());
+  int segmentCount = 0, spawnCount = 0;
+  for (unsigned i = 0; i < compiled.size(); i++) {
+    for (unsigned s = 0; s < compiled[i].segments.size(); s++) ids[compiled[i].segments[s]] = segmentCount + s;
+    table[i].firstSegment = segmentCount;
+    table[i].segmentCount = compiled[i].segments.size();
+    table[i].firstSpawn = spawnCount;
+    table[i].spawnCount = compiled[i].spawns.size();
+    table[i].backdropCount = compiled[i].backdrops.size();
+    segmentCount += table[i].segmentCount;
+    spawnCount += table[i].spawnCount;
+  }
+
+  out.put(spawnCount, 4);
+  for (const Compiled &c : compiled) {
+    for (const auto &s : c.spawns) {
+      out.putString(s.first);
+      out.putVec(s.second);
+    }
+  }
+
+  // The offsets aren't known until the regions are written, so the table
+  // gets written twice
+  auto writeTable = [&out, &table]() {
+    for (const Region &r : table) {
+      out.put(r.offset, 8);
+      out.put(r.bytes, 4);
+      out.put(r.firstSegment, 4);
+      out.put(r.segmentCount, 4);
+      out.put(r.firstSpawn, 4);
+      out.put(r.spawnCount, 4);
+      out.put(r.backdropCount, 4);
+    } };
+  uint64_t tableStart = out.tell();
+  writeTable();
+
+  for (unsigned i = 0; i < compiled.size(); i++) {
+    table[i].offset = out.tell();
+    for (int index : compiled[i].segments) {
+      const Segment &s = welded[index];
+      out.putVec(s[0]);
+      out.putVec(s[1]);
+      out.put(s.getPrev() >= 0 ? ids[s.getPrev()] : -1, 4);
+      out.put(s.getNext() >= 0 ? ids[s.getNext()] : -1, 4);
+    }
+    for (const RegionData::BackdropData &b : compiled[i].backdrops) {
+      out.put(b.layer, 4);
+      out.put(b.order, 4);
+      out.put(b.image, 2);
+      out.putVec(b.position);
+      out.put(b.frame, 4);
+      out.putFloat(b.angle);
+      out.putFloat(b.scaleX);
+      out.putFloat(b.scaleY);
+      out.put(b.flipH, 1);
+      out.put(b.flipV, 1);
+    }
+    table[i].bytes = out.tell() - table[i].offset;
+  }
+
+  out.seek(tableStart);
+  writeTable();
+  out.finish();
+
+  std::cout << "SceneStreamer: compiled " << xml << " (" << cols*rows << " regions, "
+	    << segmentCount << " segments, " << weld.before << " before merging, "
+	    << weld.welded << " ends welded, " << weld.dropped << " dropped)" << std::endl;
+}
@@ -0,0 +1,207 @@
+#ifndef SCENESTREAMER_H
+#define SCENESTREAMER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include "vector2.h"
+#include "segment.h"
+
+class Actor;
+class Backdrop;
+class BinaryReader;
+class EntityIDs;
+
+/*
+ * Plays a scene a piece at a time, so the size of the cave doesn't decide how
+ * much memory it takes. The scene is cut into square regions, and only the
+ * regions near the view have their collision and backdrops in the
+ * PhysicsManager and Canvas. Regions get read on a loading thread as the view
+ * comes near them and are handed back to the main thread to put in, and get
+ * taken out again once the view is far enough away.
+ *
+ * Enemies spawn once their spawn's region is in, and go away (to spawn fresh
+ * later) if they end up somewhere that isn't. Ones that die stay dead, and so
+ * do ones in a region that couldn't be read.
+ *
+ * Scenes are read from assets/scenes/<name>.scn, which is compiled from the
+ * scene's XML whenever it's missing, older than the XML, or was compiled with
+ * other collision settings. Compiling welds and merges the collision (see
+ * SegmentWeld).
+ *
+ * File layout, little-endian:
+ *   char[4] "SCN2"
+ *   f32     weld distance, merge distance, max length   (collision settings)
+ *   u32     width, height, region size, columns, rows
+ *   u16     entry count;  entries: string name, vec position, u8 left
+ *   u16     layer count;  layers:  i32 id, f32 scroll, string background, f32 bgAlpha
+ *   u16     image count;  images:  string file
+ *   u32     spawn count;  spawns:  string model, vec position   (by region)
+ *   regions (columns*rows, row by row):
+ *     u64 offset, u32 bytes, u32 first segment, u32 segment count,
+ *     u32 first spawn, u32 spawn count, u32 backdrop count
+ *   region blobs:
+ *     segments:  vec a, vec b, i32 prev, i32 next   (segment ids, -1 for none)
+ *     backdrops: i32 layer, u32 order, i16 image (-1 for none), vec position,
+ *                i32 frame, f32 angle, f32 scaleX, f32 scaleY, u8 flipH, u8 flipV
+ *
+ * Strings are a u16 length and the characters, vecs are two f32s.
+ */
+class SceneStreamer
+{
+ public:
+  static SceneStreamer &getInstance();
+  ~SceneStreamer();
+
+  // Regions are this big when compiled (opened files keep their own size)
+  static const int REGION_SIZE = 4096;
+
+  // Compiles the scene if needed, sets up the world, entry points and layers,
+  // and builds the nav graph from every region's collision. No region is left
+  // loaded; they come in on update() or loadAround().
+  void open(const std::string &scene);
+  void close();
+  bool isOpen() const { return !file.empty(); }
+
+  // Puts in whatever finished loading, asks for regions near either point,
+  // drops far ones, and spawns or despawns enemies to match
+  void update(const Vec2f &a, const Vec2f &b);
+
+  // Loads the regions near the position right away, without the thread
+  void loadAround(const Vec2f &position);
+
+  // Loads every region update() asks for right away too, so what's in on each
+  // frame doesn't depend on how fast the thread is. For recording and replays.
+  void setSynchronous(bool s) { synchronous = s; }
+
+  // Enemies that haven't been killed yet, spawned or not
+  int getEnemiesLeft() const;
+
+  // For snapshots: per spawn, its actor's ID, -1 if it's waiting to spawn or
+  // -2 if it's dead
+  void saveSpawns(std::vector<int>&, const EntityIDs&) const;
+  void restoreSpawns(const std::vector<int>&, const EntityIDs&);
+
+  int getRegionCount() const { return regions.size(); }
+  int getLoadedCount() const { return loaded.size(); }
+  int getPendingCount() const { return pending; }
+
+  SceneStreamer(const SceneStreamer&) = delete;
+  SceneStreamer &operator=(const SceneStreamer&) = delete;
+
+ private:
+  SceneStreamer();
+
+  enum RegionState
+  {
+    REGION_UNLOADED,
+    REGION_PENDING,
+    REGION_LOADED,
+    REGION_FAILED // The loading thread couldn't read it, so it doesn't get asked for again
+  };
+
+  struct Region
+  {
+    Region() : offset(0), bytes(0), firstSegment(0), segmentCount(0), firstSpawn(0), spawnCount(0),
+      backdropCount(0), state(REGION_UNLOADED), segments(), backdrops() {}
+    uint64_t offset;
+    unsigned bytes;
+    int firstSegment, segmentCount, firstSpawn, spawnCount, backdropCount;
+    RegionState state;
+
+    // What got put in, so it can be taken out again
+    std::vector<Segment> segments;
+    std::vector< std::pair<int, const Backdrop*> > backdrops;
+  };
+
+  // A region read off the disk, waiting to be put in on the main thread
+  struct RegionData
+  {
+    RegionData() : region(-1), generation(0), segments(), backdrops(), error() {}
+
+    struct BackdropData
+    {
+      BackdropData() : layer(0), order(0), image(-1), position(), frame(0), angle(0.f), scaleX(1.f), scaleY(1.f),
+	flipH(false), flipV(false) {}
+      BackdropData(int l, int o, int i, const Vec2f &p, int f, float a, float sx, float sy, bool fh, bool fv) :
+	layer(l), order(o), image(i), position(p), frame(f), angle(a), scaleX(sx), scaleY(sy), flipH(fh), flipV(fv) {}
+
+      int layer, order, image;
+      Vec2f position;
+      int frame;
+      float angle, scaleX, scaleY;
+      bool flipH, flipV;
+    };
+
+    int region;
+    unsigned generation;
+    std::vector<Segment> segments;
+    std::vector<BackdropData> backdrops;
+    std::string error; // Why it couldn't be read, if it couldn't
+  };
+
+  struct Spawn
+  {
+    enum State { WAITING, ALIVE, DEAD };
+    Spawn() : model(), position(), region(0), state(WAITING), actor(nullptr) {}
+    Spawn(const Spawn&) = default;
+    Spawn &operator=(const Spawn&) = default;
+    std::string model;
+    Vec2f position;
+    int region;
+    State state;
+    Actor *actor;
+  };
+
+  std::string file;
+  int regionSize, cols, rows;
+  std::vector<Region> regions;
+  std::vector<int> loaded;
+  std::vector<std::string> images;
+  std::vector<Spawn> spawns;
+  int pending;
+  bool synchronous;
+
+  int regionAt(const Vec2f &position) const;
+  float distanceTo(int region, const Vec2f &position) const;
+  template <typename F> void forEachNear(const Vec2f &position, float dist, F &&f) const;
+
+  void request(int region);
+  void install(RegionData&);
+  void fail(int region, const std::string &error);
+  void uninstall(int region);
+  void updateSpawns();
+
+  static void compile(const std::string &xml, const std::string &scn);
+  static void compileTo(const std::string &xml, const std::string &file);
+  static void readRegion(BinaryReader&, const Region&, RegionData&);
+  static void readSegments(BinaryReader&, const Region&, std::vector<Segment>&);
+
+  //
+  // Loading thread
+  //
+  struct Request
+  {
+    std::string file;
+    int region;
+    unsigned generation;
+    Region info;
+  };
+
+  std::thread loader;
+  std::mutex loadMutex;
+  std::condition_variable loadSignal;
+  std::deque<Request> requests;
+  std::deque<RegionData> results;
+  bool stopLoading;
+  unsigned generation; // Goes up every time a scene is opened or closed, to throw out old results
+
+  void loadThread();
+};
+
+#endif
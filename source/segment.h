@@ -6,16 +6,27 @@
 class Segment
 {
  public:
-  Segment(const Vec2f &a, const Vec2f &b) : v{a, b} {}
-  Segment() : v{Vec2f(), Vec2f()} {}
+  Segment(const Vec2f &a, const Vec2f &b, int i = -1, int p = -1, int n = -1) : v{a, b}, id(i), prev(p), next(n) {}
+  Segment() : v{Vec2f(), Vec2f()}, id(-1), prev(-1), next(-1) {}
   
   Vec2f &operator[](int index) { return v[index]; }
   const Vec2f &operator[](int index) const { return v[index]; }
 
   Vec2f getCenter() const { return (v[0]+v[1])*.5f; }
+
+  // Numbered across the whole scene when it's compiled (see SceneStreamer),
+  // -1 for segments made some other way
+  int getID() const { return id; }
+
+  // The segment whose end is this one's start, and the one whose start is
+  // this one's end, by ID. -1 where the line stops (or branches).
+  int getPrev() const { return prev; }
+  int getNext() const { return next; }
+  void setLinks(int p, int n) { prev = p; next = n; }
   
  private:
   Vec2f v[2];
+  int id, prev, next;
 };
 
 #endif
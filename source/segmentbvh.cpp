@@ -0,0 +1,210 @@
+#include "segmentbvh.h"
+
+namespace {
+
+BoundingBox segmentBox(const Segment &s)
+{
+  return BoundingBox( std::min(s[0][0], s[1][0]), std::min(s[0][1], s[1][1]),
+		      std::max(s[0][0], s[1][0]), std::max(s[0][1], s[1][1]) );
+}
+
+BoundingBox emptyBox()
+{
+  return BoundingBox(INFINITY, INFINITY, -INFINITY, -INFINITY);
+}
+
+void grow(BoundingBox &box, const BoundingBox &o)
+{
+  box[0] = std::min(box[0], o[0]);
+  box[1] = std::min(box[1], o[1]);
+  box[2] = std::max(box[2], o[2]);
+  box[3] = std::max(box[3], o[3]);
+}
+
+// The 2D stand in for surface area. Empty boxes cost nothing.
+float perimeter(const BoundingBox &box)
+{
+  return box[2] < box[0] ? 0.f : (box[2]-box[0]) + (box[3]-box[1]);
+}
+
+}
+
+void SegmentBVH::build()
+{
+  nodes.clear();
+  if (segments.empty()) return;
+
+  nodes.reserve(segments.size() * 2 / MAX_LEAF + 1);
+  nodes.emplace_back();
+  buildNode(0, 0, segments.size(), 0);
+}
+
+void SegmentBVH::buildNode(int node, int first, int count, int depth)
+{
+  BoundingBox bounds = emptyBox(), centers = emptyBox();
+  for (int i = first; i < first + count; i++) {
+    const Segment &s = segments[i];
+    grow(bounds, segmentBox(s));
+    Vec2f c = s.getCenter();
+    grow(centers, BoundingBox(c[0], c[1], c[0], c[1]));
+  }
+  nodes[node].box = bounds;
+
+  auto makeLeaf = [&]() {
+    nodes[node].first = first;
+    nodes[node].count = count;
+  };
+
+  int axis = centers[2]-centers[0] >= centers[3]-centers[1] ? 0 : 1;
+  float lo = centers[axis], extent = centers[axis+2] - lo;
+  if (count <= MAX_LEAF || depth >= MAX_DEPTH || extent <= 0.f) return makeLeaf();
+
+  // Sort the segments' centers into bins along the longer side
+  struct Bin
+  {
+    Bin() : box(emptyBox()), count(0) {}
+    BoundingBox box;
+    int count;
+  };
+  Bin bins[BINS];
+  auto binOf = [&](const Segment &s) {
+    return std::min(BINS-1, static_cast<int>((s.getCenter()[axis] - lo) * BINS / extent)); };
+  for (int i = first; i < first + count; i++) {
+    Bin &b = bins[binOf(segments[i])];
+    grow(b.box, segmentBox(segments[i]));
+    b.count++;
+  }
+
+  // Cost of splitting after each bin, from both ends
+  float rightCost[BINS];
+  BoundingBox box = emptyBox();
+  for (int i = BINS-1, n = 0; i > 0; i--) {
+    grow(box, bins[i].box);
+    n += bins[i].count;
+    rightCost[i] = n * perimeter(box);
+  }
+
+  int split = -1;
+  float best = count * perimeter(bounds); // Not splitting at all
+  box = emptyBox();
+  for (int i = 0, n = 0; i < BINS-1; i++) {
+    grow(box, bins[i].box);
+    n += bins[i].count;
+    float cost = n * perimeter(box) + rightCost[i+1];
+    if (n > 0 && n < count && cost < best) {
+      best = cost;
+      split = i;
+    }
+  }
+
+  // Splitting doesn't pay, unless the leaf would be too big
+  if (split < 0) {
+    if (count <= MAX_LEAF*2) return makeLeaf();
+    split = BINS/2 - 1;
+  }
+
+  Segment *mid = std::partition(segments.data() + first, segments.data() + first + count,
+				[&](const Segment &s) { return binOf(s) <= split; });
+  int leftCount = mid - (segments.data() + first);
+  if (leftCount == 0 || leftCount == count) {
+    // Everything landed on one side, so just halve it
+    leftCount = count/2;
+    std::nth_element(segments.begin() + first, segments.begin() + first + leftCount, segments.begin() + first + count,
+		     [axis](const Segment &a, const Segment &b) { return a.getCenter()[axis] < b.getCenter()[axis]; });
+  }
+
+  // The left child goes right after this one, the right one after the left's subtree
+  int left = nodes.size();
+  nodes.emplace_back();
+  buildNode(left, first, leftCount, depth+1);
+  int right = nodes.size();
+  nodes.emplace_back();
+  nodes[node].first = right;
+  nodes[node].count = 0;
+  buildNode(right, first + leftCount, count - leftCount, depth+1);
+}
+
+const Segment *SegmentBVH::nearest(const Vec2f &p, float maxDist, Vec2f *closest) const
+{
+  if (nodes.empty()) return nullptr;
+
+  const Segment *found = nullptr;
+  float bestSq = maxDist * maxDist;
+
+  int stack[MAX_DEPTH*2], top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node &n = nodes[stack[--top]];
+    float d = boxDistance(n.box, p);
+    if (d*d > bestSq) continue;
+
+    if (n.count > 0) {
+      for (int i = n.first; i < n.first + n.count; i++) {
+	Vec2f c = closestPoint(segments[i], p);
+	float distSq = (c - p).lengthSquared();
+	if (distSq <= bestSq) {
+	  bestSq = distSq;
+	  found = &segments[i];
+	  if (closest != nullptr) *closest = c;
+	}
+      }
+      continue;
+    }
+
+    // Closer child on top
+    int near = &n - nodes.data() + 1, far = n.first;
+    if (boxDistance(nodes[far].box, p) < boxDistance(nodes[near].box, p)) std::swap(near, far);
+    stack[top++] = far;
+    stack[top++] = near;
+  }
+  return found;
+}
+
+bool SegmentBVH::segmentBoxIntersect(const Segment &s, const BoundingBox &box)
+{
+  // Clip the segment to the box, one axis at a time
+  Vec2f a = s[0], d = s[1] - s[0];
+  float t0 = 0.f, t1 = 1.f;
+  for (int i = 0; i < 2; i++) {
+    if (d[i] == 0.f) {
+      if (a[i] < box[i] || a[i] > box[i+2]) return false;
+      continue;
+    }
+    float ta = (box[i] - a[i]) / d[i], tb = (box[i+2] - a[i]) / d[i];
+    t0 = std::max(t0, std::min(ta, tb));
+    t1 = std::min(t1, std::max(ta, tb));
+    if (t0 > t1) return false;
+  }
+  return true;
+}
+
+Vec2f SegmentBVH::closestPoint(const Segment &s, const Vec2f &p)
+{
+  Vec2f d = s[1] - s[0];
+  float lenSq = d.lengthSquared();
+  if (lenSq <= 0.f) return s[0];
+  float t = std::min(std::max((p - s[0]).dot(d) / lenSq, 0.f), 1.f);
+  return s[0] + d*t;
+}
+
+float SegmentBVH::rayBox(const Vec2f &a, const Vec2f &inv, const BoundingBox &box)
+{
+  float t0 = 0.f, t1 = 1.f;
+  for (int i = 0; i < 2; i++) {
+    if (std::isinf(inv[i])) {
+      if (a[i] < box[i] || a[i] > box[i+2]) return -1.f;
+      continue;
+    }
+    float ta = (box[i] - a[i]) * inv[i], tb = (box[i+2] - a[i]) * inv[i];
+    t0 = std::max(t0, std::min(ta, tb));
+    t1 = std::min(t1, std::max(ta, tb));
+  }
+  return t0 <= t1 ? t0 : -1.f;
+}
+
+float SegmentBVH::boxDistance(const BoundingBox &box, const Vec2f &p)
+{
+  float dx = std::max(std::max(box[0] - p[0], p[0] - box[2]), 0.f),
+    dy = std::max(std::max(box[1] - p[1], p[1] - box[3]), 0.f);
+  return std::sqrt(dx*dx + dy*dy);
+}
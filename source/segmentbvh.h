@@ -0,0 +1,142 @@
+#ifndef SEGMENTBVH_H
+#define SEGMENTBVH_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "segment.h"
+#include "boundingbox.h"
+
+/*
+ * A bounding volume hierarchy over the world's segments, for queries that
+ * don't stay near one spot: rays of any length, boxes of any size, and the
+ * closest segment to a point. Built in one go from a list of segments (with
+ * a binned surface area heuristic, where the "area" of a 2D box is its
+ * perimeter) and never changed after, so anything that changes the segments
+ * means building it again.
+ *
+ * The segments are copied in, in the order the tree wants them.
+ */
+class SegmentBVH
+{
+ public:
+  SegmentBVH() : nodes(), segments() {}
+
+  template <typename It>
+  void build(It first, It last) {
+    segments.assign(first, last);
+    build();
+  }
+  void clear() { nodes.clear(); segments.clear(); }
+
+  int getNodeCount() const { return nodes.size(); }
+  int getSegmentCount() const { return segments.size(); }
+  size_t getMemoryUsage() const { return nodes.capacity() * sizeof(Node) + segments.capacity() * sizeof(Segment); }
+
+  // Calls f for every segment whose box the line from a to b passes through,
+  // nearer boxes first. Stops and returns true as soon as f does. With maxT,
+  // boxes the line only reaches past *maxT (as a fraction of a to b) are
+  // skipped, so a caller keeping its closest hit there can shrink it as it goes.
+  template <typename F>
+  bool queryRay(const Vec2f &a, const Vec2f &b, F &&f, const float *maxT = nullptr) const;
+
+  // Calls f for every segment that touches the box (left, top, right, bottom)
+  template <typename F>
+  void queryBox(const BoundingBox &box, F &&f) const;
+
+  // The closest segment to the point within maxDist (nullptr if there's
+  // none), and the closest point on it
+  const Segment *nearest(const Vec2f &p, float maxDist, Vec2f *closest = nullptr) const;
+
+  static bool segmentBoxIntersect(const Segment&, const BoundingBox&);
+  static Vec2f closestPoint(const Segment&, const Vec2f &p);
+
+ private:
+  // Children of an inner node are the next node and nodes[first]. Leaves
+  // have their segments at segments[first, first+count).
+  struct Node
+  {
+    Node() : box(0, 0, 0, 0), first(0), count(0) {}
+    BoundingBox box;
+    int first, count;
+  };
+
+  std::vector<Node> nodes;
+  std::vector<Segment> segments;
+
+  static const int MAX_LEAF = 4;
+  static const int BINS = 16;
+  static const int MAX_DEPTH = 64;
+
+  void build();
+  void buildNode(int node, int first, int count, int depth);
+
+  // Where the line enters the box (as a fraction of a to b), or -1 if it misses
+  static float rayBox(const Vec2f &a, const Vec2f &inv, const BoundingBox&);
+  static float boxDistance(const BoundingBox&, const Vec2f &p);
+  static bool overlap(const BoundingBox &a, const BoundingBox &b) {
+    return a[0] <= b[2] && b[0] <= a[2] && a[1] <= b[3] && b[1] <= a[3]; }
+};
+
+template <typename F>
+bool SegmentBVH::queryRay(const Vec2f &a, const Vec2f &b, F &&f, const float *maxT) const
+{
+  if (nodes.empty()) return false;
+
+  Vec2f d = b - a;
+  Vec2f inv(d[0] != 0.f ? 1.f/d[0] : INFINITY, d[1] != 0.f ? 1.f/d[1] : INFINITY);
+  float tRoot = rayBox(a, inv, nodes[0].box);
+  if (tRoot < 0.f) return false;
+
+  // Nodes along with where the line enters them, since the closest hit may
+  // have moved up by the time they come off
+  int stack[MAX_DEPTH*2], top = 0;
+  float entry[MAX_DEPTH*2];
+  entry[top] = tRoot;
+  stack[top++] = 0;
+  while (top > 0) {
+    --top;
+    if (maxT != nullptr && entry[top] > *maxT) continue;
+    const Node &n = nodes[stack[top]];
+    if (n.count > 0) {
+      for (int i = n.first; i < n.first + n.count; i++)
+	if (f(segments[i])) return true;
+      continue;
+    }
+
+    // Push the farther child first, so the nearer one comes off next
+    int near = &n - nodes.data() + 1, far = n.first;
+    float tNear = rayBox(a, inv, nodes[near].box), tFar = rayBox(a, inv, nodes[far].box);
+    if (tFar >= 0.f && tNear >= 0.f && tFar < tNear) {
+      std::swap(near, far);
+      std::swap(tNear, tFar);
+    }
+    if (tFar >= 0.f) { entry[top] = tFar; stack[top++] = far; }
+    if (tNear >= 0.f) { entry[top] = tNear; stack[top++] = near; }
+  }
+  return false;
+}
+
+template <typename F>
+void SegmentBVH::queryBox(const BoundingBox &box, F &&f) const
+{
+  if (nodes.empty() || !overlap(nodes[0].box, box)) return;
+
+  int stack[MAX_DEPTH*2], top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node &n = nodes[stack[--top]];
+    if (n.count > 0) {
+      for (int i = n.first; i < n.first + n.count; i++)
+	if (segmentBoxIntersect(segments[i], box)) f(segments[i]);
+      continue;
+    }
+
+    int left = &n - nodes.data() + 1, right = n.first;
+    if (overlap(nodes[right].box, box)) stack[top++] = right;
+    if (overlap(nodes[left].box, box)) stack[top++] = left;
+  }
+}
+
+#endif
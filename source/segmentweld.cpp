@@ -0,0 +1,124 @@
+#include "segmentweld.h"
+#include "cellmap.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+// Whether the points between a and b are all close enough to the line from a
+// to b (and in order along it) to leave out
+bool straight(const Vec2f &a, const Vec2f &b, const std::vector<Vec2f> &between, float mergeDist, float maxLength)
+{
+  Vec2f d = b - a;
+  float length = d.length();
+  if (length <= 0.f || length > maxLength) return false;
+  d = d / length;
+
+  float along = 0.f;
+  for (const Vec2f &p : between) {
+    float t = (p - a).dot(d);
+    if (t <= along || t >= length || std::fabs((p - a).cross(d)) > mergeDist) return false;
+    along = t;
+  }
+  return true;
+}
+
+}
+
+SegmentWeld::Result SegmentWeld::run(std::vector<Segment> &segments, float weldDist, float mergeDist, float maxLength)
+{
+  Result result = { static_cast<int>(segments.size()), 0, 0, 0 };
+
+  // Every end becomes the first point found within weldDist of it, or a new
+  // one. Points go in cells weldDist wide, so only the 3x3 around one needs looking at.
+  float cellSize = std::max(weldDist, .01f);
+  auto coord = [cellSize](float v) {
+    return static_cast<int>(std::min(std::max(std::floor(v / cellSize), -1e9f), 1e9f)); };
+
+  std::vector<Vec2f> points;
+  CellMap< std::vector<int> > cells;
+  auto pointAt = [&](const Vec2f &p) {
+    int x = coord(p[0]), y = coord(p[1]);
+    for (int cy = y-1; cy <= y+1; cy++) {
+      for (int cx = x-1; cx <= x+1; cx++) {
+	const std::vector<int> *list = cells.find({cx, cy});
+	if (list == nullptr) continue;
+	for (int i : *list) if ((points[i] - p).length() <= weldDist) return i;
+      }
+    }
+    cells[{x, y}].push_back(points.size());
+    points.push_back(p);
+    return static_cast<int>(points.size()) - 1;
+  };
+
+  std::vector<int> start, end;
+  for (const Segment &s : segments) {
+    int a = pointAt(s[0]), b = pointAt(s[1]);
+    if (points[a] != s[0]) result.welded++;
+    if (points[b] != s[1]) result.welded++;
+    if (a == b) {
+      result.dropped++;
+      continue;
+    }
+    start.push_back(a);
+    end.push_back(b);
+  }
+  int count = start.size();
+
+  // A segment carries on into the next one if nothing else starts or ends there
+  std::vector<int> starting(points.size(), 0), ending(points.size(), 0), startsAt(points.size(), -1);
+  for (int i = 0; i < count; i++) {
+    starting[start[i]]++;
+    ending[end[i]]++;
+    startsAt[start[i]] = i;
+  }
+  std::vector<int> next(count, -1);
+  std::vector<bool> hasPrev(count, false);
+  for (int i = 0; i < count; i++) {
+    int p = end[i];
+    if (starting[p] == 1 && ending[p] == 1) {
+      next[i] = startsAt[p];
+      hasPrev[next[i]] = true;
+    }
+  }
+
+  // Walk each line from its start, merging as far as it stays straight.
+  // Closed loops (where nothing is a start) go last, from anywhere on them.
+  std::vector<Segment> merged;
+  std::vector<bool> done(count, false);
+  auto walk = [&](int first) {
+    int firstOut = merged.size(), lastOut = -1, i = first;
+    while (i >= 0 && !done[i]) {
+      Vec2f a = points[start[i]], b = points[end[i]];
+      std::vector<Vec2f> between;
+      done[i] = true;
+      i = next[i];
+      while (i >= 0 && !done[i]) {
+	between.push_back(b);
+	if (!straight(a, points[end[i]], between, mergeDist, maxLength)) {
+	  between.pop_back();
+	  break;
+	}
+	b = points[end[i]];
+	done[i] = true;
+	i = next[i];
+      }
+
+      merged.emplace_back(a, b, -1, lastOut, -1);
+      if (lastOut >= 0) merged[lastOut].setLinks(merged[lastOut].getPrev(), merged.size()-1);
+      lastOut = merged.size()-1;
+    }
+
+    if (i == first && lastOut >= 0) {
+      merged[lastOut].setLinks(merged[lastOut].getPrev(), firstOut);
+      merged[firstOut].setLinks(lastOut, merged[firstOut].getNext());
+    }
+  };
+  for (int i = 0; i < count; i++) if (!hasPrev[i]) walk(i);
+  for (int i = 0; i < count; i++) if (!done[i]) walk(i);
+
+  segments.swap(merged);
+  result.after = segments.size();
+  return result;
+}
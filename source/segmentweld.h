@@ -0,0 +1,32 @@
+#ifndef SEGMENTWELD_H
+#define SEGMENTWELD_H
+
+#include <vector>
+
+#include "segment.h"
+
+/*
+ * Tidies up a scene's collision before it gets compiled (see SceneStreamer).
+ * The editor builds walls out of short segments extruded one after another, so
+ * ends closer than weldDist get welded into one point, and runs of segments
+ * that stay within mergeDist of a straight line become one segment (no longer
+ * than maxLength). Segments get linked up to the ones before and after them,
+ * by index into the list.
+ *
+ * Lines only carry on through points where exactly one segment ends and one
+ * starts, so branches stay apart and a wall never joins one facing the other way.
+ */
+class SegmentWeld
+{
+ public:
+  struct Result
+  {
+    int before, after;  // Segments going in and coming out
+    int welded;         // Ends that got moved
+    int dropped;        // Segments that welded down to nothing
+  };
+
+  static Result run(std::vector<Segment>&, float weldDist, float mergeDist, float maxLength);
+};
+
+#endif
@@ -1,19 +1,32 @@
 #include "soundmanager.h"
 #include "gameconfig.h"
+#include "viewport.h"
+#include "soundset.h"
+
+#include "xmlparser.h"
 
 #include <SDL.h>
 #include <iostream>
+#include <fstream>
+#include <algorithm>
 
-Sound::Sound(Mix_Chunk *c) : chunk(c) {}
+Sound::Sound(const std::string &f) : file(f), chunk(nullptr), queued(false), lastPlayed(0) {}
 
 Sound::~Sound()
 {
-  Mix_FreeChunk(chunk);
+  if (chunk.load() != nullptr) Mix_FreeChunk(chunk);
 }
 
-int Sound::play(int times) const
+int Sound::play(int channel, int times) const
 {
-  return Mix_PlayChannel(-1, chunk, times);
+  Mix_Chunk *c = chunk.load();
+  return c == nullptr ? -1 : Mix_PlayChannel(channel, c, times);
+}
+
+unsigned Sound::getSize() const
+{
+  Mix_Chunk *c = chunk.load();
+  return c == nullptr ? 0 : c->alen;
 }
 
 SoundManager &SoundManager::getInstance()
@@ -24,8 +37,18 @@ SoundManager &SoundManager::getInstance()
 
 SoundManager::~SoundManager() {
   std::cout << "Cleaning up sounds ..." << std::endl;
+
+  {
+    std::lock_guard<std::mutex> lock(loadMutex);
+    stopLoading = true;
+  }
+  loadSignal.notify_all();
+  loader.join();
+
   Mix_HaltMusic();
-  Mix_FreeMusic(music);
+  if (music == nullptr) music = loadedMusic.exchange(nullptr);
+  if (music != nullptr) Mix_FreeMusic(music);
+  Mix_HaltChannel(-1);
   for (auto &it : sounds) delete it.second;
   Mix_CloseAudio();
 }
@@ -36,20 +59,149 @@ SoundManager::SoundManager() :
   audioRate(44100), 
   audioChannels( 2 ), 
   audioBuffers( 1024 ),
-  sounds()
+  sounds(),
+  voices(GameConfig::getInstance().get().maxVoices),
+  playCounter(0),
+  culled(0),
+  stolen(0),
+  deferred(),
+  loader(),
+  loadMutex(),
+  loadSignal(),
+  loadQueue(),
+  stopLoading(false),
+  musicRequested(true),
+  loadedMusic(nullptr),
+  cacheBytes(0),
+  cacheBudget(GameConfig::getInstance().get().soundCacheKB * 1024),
+  created(std::chrono::steady_clock::now()),
+  startupTime(0.f),
+  readyTime(-1.f)
 {
   if(Mix_OpenAudio(audioRate, MIX_DEFAULT_FORMAT, audioChannels, 
                    audioBuffers)){
     throw std::string("Unable to open audio!");
   }
 
-  Mix_AllocateChannels(64);
+  Mix_AllocateChannels(voices.size());
+
+  // Music and sounds get opened and decoded on their own thread, so the first
+  // frame doesn't have to wait for them. Music starts in update() once ready.
+  loader = std::thread(&SoundManager::loadThread, this);
+
+  startupTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - created).count();
+  std::cout << "SoundManager: started in " << startupTime << "ms" << std::endl;
+}
+
+void SoundManager::update()
+{
+  // Music finished opening on the loading thread
+  if (music == nullptr && (music = loadedMusic.exchange(nullptr)) != nullptr)
+    startMusic();
+
+  playDeferred();
+  trimCache();
+}
+
+void SoundManager::preloadManifest(const std::string &scene)
+{
+  std::ifstream test("assets/scenes/manifests/" + scene + ".xml");
+  if (!test.is_open()) return;
+
+  XMLParser parser("assets/scenes/manifests/" + scene + ".xml");
+  for (const XMLTag *t : parser.getTag("manifest").getChildren())
+    if (t->getName() == "sound") getSound(t->toStr());
+}
+
+int SoundManager::getLoadedCount() const
+{
+  int count = 0;
+  for (const auto &it : sounds)
+    if (it.second->isLoaded()) count++;
+  return count;
+}
+
+void SoundManager::queueLoad(const Sound *sound)
+{
+  if (sound->queued.exchange(true)) return;
+  {
+    std::lock_guard<std::mutex> lock(loadMutex);
+    loadQueue.push_back(sound);
+  }
+  loadSignal.notify_one();
+}
+
+void SoundManager::loadThread()
+{
+  while (true) {
+    const Sound *sound = nullptr;
+    bool loadMusic = false;
+    {
+      std::unique_lock<std::mutex> lock(loadMutex);
+      loadSignal.wait(lock, [this]() { return stopLoading || musicRequested || !loadQueue.empty(); });
+      if (stopLoading) return;
+
+      if (musicRequested) {
+	musicRequested = false;
+	loadMusic = true;
+      } else {
+	sound = loadQueue.front();
+	loadQueue.pop_front();
+      }
+    }
+
+    // Mix_Music only decodes as it plays, so opening it is all there is to do here
+    if (loadMusic) {
+      Mix_Music *m = Mix_LoadMUS("assets/sounds/music.ogg");
+      if (m == nullptr) std::cout << "SoundManager: unable to load music!" << std::endl;
+      loadedMusic = m;
+      continue;
+    }
+
+    if (sound->chunk.load() == nullptr) {
+      std::string file = "assets/sounds/" + sound->file;
+      Mix_Chunk *c = Mix_LoadWAV(file.c_str());
+      if (c == nullptr) std::cout << "SoundManager: unable to load sound '" + file + "'" << std::endl;
+      else {
+	cacheBytes += c->alen;
+	sound->chunk = c;
+      }
+    }
+    sound->queued = false;
+
+    // Record the first time everything asked for so far is ready
+    std::lock_guard<std::mutex> lock(loadMutex);
+    if (loadQueue.empty() && readyTime < 0.f) {
+      readyTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - created).count();
+      std::cout << "SoundManager: sounds ready after " << readyTime << "ms" << std::endl;
+    }
+  }
+}
+
+void SoundManager::trimCache()
+{
+  if (cacheBytes <= cacheBudget) return;
+
+  // Throw out the sounds that have gone the longest without playing, skipping
+  // any that are still playing on a voice.
+  std::vector<Sound*> candidates;
+  for (auto &it : sounds)
+    if (it.second->isLoaded()) candidates.push_back(it.second);
+  std::sort(candidates.begin(), candidates.end(), [](const Sound *a, const Sound *b) {
+      return a->lastPlayed < b->lastPlayed; });
 
-  // Load music
-  if ((music = Mix_LoadMUS("assets/sounds/music.ogg")) == nullptr)
-    throw std::string("Enable to load music!");
-  
-  startMusic();
+  for (Sound *s : candidates) {
+    if (cacheBytes <= cacheBudget) break;
+
+    bool playing = false;
+    for (unsigned i = 0; i < voices.size() && !playing; i++)
+      playing = voices[i].sound == s && Mix_Playing(i);
+    if (playing) continue;
+
+    Mix_Chunk *c = s->chunk.exchange(nullptr);
+    cacheBytes -= c->alen;
+    Mix_FreeChunk(c);
+  }
 }
 
 void SoundManager::toggleMusic() {
@@ -62,13 +214,15 @@ void SoundManager::toggleMusic() {
 }
 
 void SoundManager::startMusic() {
+  if (music == nullptr) return;
   Mix_VolumeMusic(volume*2);
   Mix_PlayMusic(music, -1);
 }
 
 void SoundManager::stopMusic() {
   Mix_HaltMusic();
-  Mix_FreeMusic(music);
+  if (music != nullptr) Mix_FreeMusic(music);
+  music = nullptr;
 }
 
 void SoundManager::stopSound(int channel) const
@@ -80,9 +234,126 @@ const Sound *SoundManager::getSound(const std::string &name)
 {
   auto result = sounds.find(name);
   if (result == sounds.end()) {
-    std::string file = "assets/sounds/" + name;
-    std::cout << "SoundManager: loading sound '" + file + "'" << std::endl;
-    return sounds[name] = new Sound( Mix_LoadWAV((file).c_str()) );
+    Sound *sound = sounds[name] = new Sound(name);
+    queueLoad(sound);
+    return sound;
   }
   else return result->second;
 }
+
+int SoundManager::getActiveVoiceCount() const
+{
+  int count = 0;
+  for (unsigned i = 0; i < voices.size(); i++)
+    if (Mix_Playing(i)) count++;
+  return count;
+}
+
+int SoundManager::playSound(const Sound *sound, const VoiceParams &params, int times)
+{
+  return startVoice(sound, params, MIX_MAX_VOLUME, 255, 255, times);
+}
+
+int SoundManager::playSound(const Sound *sound, const VoiceParams &params, const Vec2f &position, int times)
+{
+  if (params.range <= 0.f)
+    return playSound(sound, params, times);
+
+  const Viewport &v = Viewport::getInstance();
+  Vec2f diff = position - v.getPosition();
+  float dist = diff.length();
+
+  // Too far away to hear, so don't waste a voice on it
+  if (dist >= params.range) {
+    culled++;
+    return -1;
+  }
+
+  // Fade out linearly with distance, and pan based on which side of the view it is on
+  float gain = 1.f - dist/params.range;
+  float pan = std::max(-1.f, std::min(1.f, diff[0] / (v.getWidth() / v.getZoomFactor())));
+  Uint8 left = 255 * std::min(1.f, 1.f - pan),
+    right = 255 * std::min(1.f, 1.f + pan);
+
+  return startVoice(sound, params, static_cast<int>(MIX_MAX_VOLUME * gain + 0.5f), left, right, times);
+}
+
+void SoundManager::playDeferred()
+{
+  auto now = std::chrono::steady_clock::now();
+  for (auto it = deferred.begin(); it != deferred.end();) {
+    if (!it->sound->isLoaded()) {
+      if (now - it->requested > std::chrono::milliseconds(MAX_DEFER_MS)) it = deferred.erase(it);
+      else ++it;
+      continue;
+    }
+
+    VoiceParams params;
+    params.priority = it->priority;
+    params.maxInstances = it->maxInstances;
+    startVoice(it->sound, params, it->volume, it->left, it->right, it->times);
+    it = deferred.erase(it);
+  }
+}
+
+int SoundManager::startVoice(const Sound *sound, const VoiceParams &params, int volume, Uint8 left, Uint8 right, int times)
+{
+  // Not decoded yet (or thrown out of the cache). Rather than stall the frame,
+  // play it once the loading thread is done with it.
+  sound->lastPlayed = playCounter;
+  if (!sound->isLoaded()) {
+    queueLoad(sound);
+    bool waiting = std::any_of(deferred.begin(), deferred.end(), [sound](const Deferred &d) { return d.sound == sound; });
+    if (!waiting)
+      deferred.push_back({sound, params.priority, params.maxInstances, volume, left, right, times,
+	    std::chrono::steady_clock::now()});
+    return -1;
+  }
+
+  int channel = -1;
+  int instances = 0, oldestInstance = -1;
+  int weakest = -1;
+
+  for (int i = 0; i < static_cast<int>(voices.size()); i++) {
+    if (!Mix_Playing(i)) {
+      if (channel < 0) channel = i;
+      continue;
+    }
+    const Voice &voice = voices[i];
+    if (voice.sound == sound) {
+      instances++;
+      if (oldestInstance < 0 || voice.started < voices[oldestInstance].started) oldestInstance = i;
+    }
+    if (weakest < 0 || voice.priority < voices[weakest].priority ||
+	(voice.priority == voices[weakest].priority && voice.started < voices[weakest].started))
+      weakest = i;
+  }
+
+  // Too many of the same sound at once just sounds like mud. Replace the oldest one.
+  if (params.maxInstances > 0 && instances >= params.maxInstances)
+    channel = oldestInstance;
+
+  // Every voice is busy, so steal the least important one if we matter more
+  else if (channel < 0) {
+    if (weakest < 0 || voices[weakest].priority > params.priority) {
+      culled++;
+      return -1;
+    }
+    channel = weakest;
+  }
+
+  if (Mix_Playing(channel)) {
+    Mix_HaltChannel(channel);
+    stolen++;
+  }
+
+  Mix_Volume(channel, volume);
+  Mix_SetPanning(channel, left, right);
+  if ((channel = sound->play(channel, times)) < 0) return -1;
+
+  Voice &voice = voices[channel];
+  voice.sound = sound;
+  voice.priority = params.priority;
+  voice.started = ++playCounter;
+  return channel;
+}
@@ -4,20 +4,44 @@
 #include <SDL_mixer.h>
 #include <string>
 #include <unordered_map>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
+#include "vector2.h"
+
+struct VoiceParams;
+
+// A handle to a sound file. The decoded samples are filled in by the
+// SoundManager's loading thread, and may be thrown out again if the cache
+// grows past its budget, so a sound is not always ready to play.
 class Sound {
  public:
-  Sound(Mix_Chunk*);
+  Sound(const std::string &file);
   ~Sound();
 
-  // Returns channel id for SoundManager to stop
-  int play(int times) const;
+  // Returns channel id for SoundManager to stop, or -1 if it isn't decoded yet
+  int play(int channel, int times) const;
+
+  bool isLoaded() const { return chunk.load() != nullptr; }
+
+  // Bytes of decoded samples held in memory
+  unsigned getSize() const;
 
   Sound(const Sound&) = delete;
   Sound &operator=(const Sound&) = delete;  
     
  private:
-  Mix_Chunk *chunk;
+  friend class SoundManager;
+
+  const std::string file;
+  mutable std::atomic<Mix_Chunk*> chunk;
+  mutable std::atomic<bool> queued;
+  mutable unsigned long lastPlayed;
 };
 
 class SoundManager {
@@ -27,14 +51,45 @@ public:
 
   static SoundManager &getInstance();
 
+  // Starts music once the loading thread has it ready, and keeps the sound
+  // cache within its budget. Call once per frame.
+  void update();
+
+  // Queues every sound listed in a scene's manifest (assets/scenes/manifests/)
+  // to be decoded on the loading thread ahead of time.
+  void preloadManifest(const std::string &scene);
+
   void startMusic();
   void stopMusic();      // stop all sounds
   void toggleMusic();    // toggle music on/off
 
   void stopSound(int channel) const;
+
+  // Plays a sound on one of the mixing voices. Positional sounds are attenuated
+  // and panned relative to the viewport, and are not played at all beyond their
+  // range. If every voice is busy, the lowest priority (then oldest) voice is
+  // stolen, unless it is more important than this one. Returns the channel, or -1
+  // if the sound was culled. A sound that isn't decoded yet starts as soon as
+  // the loading thread has it (and -1 is returned for now).
+  int playSound(const Sound*, const VoiceParams&, int times = 0);
+  int playSound(const Sound*, const VoiceParams&, const Vec2f &position, int times = 0);
+
+  int getVoiceCount() const { return voices.size(); }
+  int getActiveVoiceCount() const;
+  int getCulledCount() const { return culled; }
+  int getStolenCount() const { return stolen; }
   
+  // Never blocks. The sound is queued for decoding if it isn't cached yet.
   const Sound *getSound(const std::string &name);
 
+  // Cache and startup statistics
+  size_t getCacheSize() const { return cacheBytes; }
+  size_t getCacheBudget() const { return cacheBudget; }
+  int getLoadedCount() const;
+  int getSoundCount() const { return sounds.size(); }
+  float getStartupTime() const { return startupTime; }
+  float getReadyTime() const { return readyTime; }
+
   SoundManager(const SoundManager&) = delete;
   SoundManager &operator=(const SoundManager&) = delete;
 
@@ -47,6 +102,61 @@ public:
   int audioBuffers;
   
   std::unordered_map<std::string, Sound*> sounds;
+
+  // What each mixing channel is playing (channel id = index)
+  struct Voice
+  {
+    Voice() : sound(nullptr), priority(0), started(0) {}
+    const Sound *sound;
+    int priority;
+    unsigned long started;
+  };
+  std::vector<Voice> voices;
+  unsigned long playCounter;
+
+  // Totals since startup, mainly for the debug HUD
+  int culled, stolen;
+
+  int startVoice(const Sound*, const VoiceParams&, int volume, Uint8 left, Uint8 right, int times);
+
+  // Plays asked for before their sound was decoded. They start in update() once
+  // it is, unless it took so long they'd be out of step with the game by then.
+  struct Deferred
+  {
+    const Sound *sound;
+    int priority, maxInstances, volume;
+    Uint8 left, right;
+    int times;
+    std::chrono::time_point<std::chrono::steady_clock> requested;
+  };
+  std::vector<Deferred> deferred;
+  static const int MAX_DEFER_MS = 250;
+  void playDeferred();
+
+  //
+  // Loading thread
+  //
+  std::thread loader;
+  std::mutex loadMutex;
+  std::condition_variable loadSignal;
+  std::deque<const Sound*> loadQueue;
+  bool stopLoading;
+  bool musicRequested;
+  std::atomic<Mix_Music*> loadedMusic;
+
+  // Decoded sample memory in use, and how much we try to stay under
+  std::atomic<size_t> cacheBytes;
+  size_t cacheBudget;
+
+  // How long the constructor took, and how long until the first batch of
+  // queued sounds finished decoding (in milliseconds, -1 until then)
+  std::chrono::time_point<std::chrono::steady_clock> created;
+  float startupTime;
+  std::atomic<float> readyTime;
+
+  void queueLoad(const Sound*);
+  void loadThread();
+  void trimCache();
 };
 
 #endif
@@ -6,19 +6,32 @@
 
 SoundSet::SoundSet() :
   sounds(),
-  soundInterval(-1.f) {}
+  soundInterval(-1.f),
+  voiceParams() {}
 
 SoundSet::~SoundSet() {}
 
 SoundSet &SoundSet::operator=(const XMLTag& tag)
 {
   soundInterval = tag["interval"].toFloat();
-  std::for_each( tag.getChildren().begin()+1, tag.getChildren().end(), [this](const XMLTag *pt) {
-      sounds.push_back( SoundManager::getInstance().getSound(pt->toStr()) ); });
+
+  // Optional mixing limits
+  if (tag.hasChild("priority")) voiceParams.priority = tag["priority"].toInt();
+  if (tag.hasChild("maxInstances")) voiceParams.maxInstances = tag["maxInstances"].toInt();
+  if (tag.hasChild("range")) voiceParams.range = tag["range"].toFloat();
+
+  std::for_each( tag.getChildren().begin(), tag.getChildren().end(), [this](const XMLTag *pt) {
+      if (pt->getName() == "sound")
+	sounds.push_back( SoundManager::getInstance().getSound(pt->toStr()) ); });
   return *this;
 }
 
 int SoundSet::playSound(int id) const
 {
-  return sounds[id]->play(0);
+  return SoundManager::getInstance().playSound(sounds[id], voiceParams);
+}
+
+int SoundSet::playSound(int id, const Vec2f &position) const
+{
+  return SoundManager::getInstance().playSound(sounds[id], voiceParams, position);
 }
@@ -2,35 +2,55 @@
 #define SOUNDSET_H
 
 #include <vector>
-#include <cstdlib>
+
+#include "vector2.h"
+#include "random.h"
 
 class Sound;
 class XMLTag;
 
+// How a sound competes for one of the limited mixing voices
+struct VoiceParams
+{
+  VoiceParams() : priority(0), maxInstances(0), range(0.f) {}
+  int priority;     // Higher priority sounds steal voices from lower ones
+  int maxInstances; // How many voices the same sound may use at once (0 = no limit)
+  float range;      // Distance from the view at which the sound fades out (0 = heard everywhere)
+};
+
 class SoundSet
 {
  public:
   SoundSet();
   ~SoundSet();
   
+  // Plays sounds heard the same everywhere
   int playSound(int id) const;
   int playRandomSound() const { return playSound(randomSoundID()); }
+
+  // Plays sounds coming from somewhere in the world
+  int playSound(int id, const Vec2f &position) const;
+  int playRandomSound(const Vec2f &position) const { return playSound(randomSoundID(), position); }
+
   float getSoundInterval() const { return soundInterval; }
-  int randomSoundID() const { return rand()%sounds.size(); }
+  int randomSoundID() const { return Random::getInstance().range(sounds.size()); }
 
   int count() const { return sounds.size(); }
   bool empty() const { return count() == 0; }
 
+  const VoiceParams &getVoiceParams() const { return voiceParams; }
+
   // This is mainly how it's defined, since not all animations/states that contain soundset play sounds
   SoundSet &operator=(const XMLTag&);
 
   SoundSet(const SoundSet&) = delete;
   SoundSet &operator=(const SoundSet&) = delete;
-  SoundSet(SoundSet&& rhs) : sounds(std::move(rhs.sounds)), soundInterval(rhs.soundInterval) {}
+  SoundSet(SoundSet&& rhs) : sounds(std::move(rhs.sounds)), soundInterval(rhs.soundInterval), voiceParams(rhs.voiceParams) {}
 
  private:
   std::vector<const Sound*> sounds;
   float soundInterval; // -1 means it plays once, anything after that
+  VoiceParams voiceParams;
 };
 
 #endif
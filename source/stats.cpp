@@ -0,0 +1,61 @@
+#include "stats.h"
+
+Stats &Stats::getInstance()
+{
+  static Stats instance;
+  return instance;
+}
+
+Stats::Stats() : names(), kinds(), current(), last(), samplers(), ids() {}
+
+int Stats::add(const std::string &name, Kind kind)
+{
+  auto it = ids.find(name);
+  if (it != ids.end()) {
+    if (kinds[it->second] != kind) throw std::string("Stat " + name + " was already added as another kind");
+    return it->second;
+  }
+
+  int id = names.size();
+  names.push_back(name);
+  kinds.push_back(kind);
+  current.push_back(0.);
+  last.push_back(0.);
+  samplers.emplace_back();
+  ids[name] = id;
+  return id;
+}
+
+int Stats::addGauge(const std::string &name, std::function<double()> &&sample)
+{
+  int id = add(name, GAUGE);
+  samplers[id] = std::move(sample);
+  return id;
+}
+
+double Stats::get(int id) const
+{
+  if (samplers[id]) return samplers[id]();
+  return kinds[id] == GAUGE ? current[id] : last[id];
+}
+
+void Stats::endFrame()
+{
+  for (size_t i = 0; i < current.size(); i++) {
+    if (kinds[i] == GAUGE) continue;
+    last[i] = current[i];
+    current[i] = 0.;
+  }
+}
+
+void Stats::dump(std::ostream &out) const
+{
+  static const char *kindNames[] = { "counter", "gauge", "timer" };
+
+  out << "{\n";
+  for (size_t i = 0; i < names.size(); i++) {
+    out << "  \"" << names[i] << "\": { \"kind\": \"" << kindNames[kinds[i]] << "\", \"value\": " << get(i) << " }"
+	<< (i+1 < names.size() ? ",\n" : "\n");
+  }
+  out << "}\n";
+}
@@ -0,0 +1,77 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <chrono>
+#include <ostream>
+
+/*
+ * Numbers the engine keeps about itself. Subsystems register a stat once and
+ * then just update a number, and nothing gets turned into text unless the
+ * debug HUD is showing (and then only a few times a second) or someone asks
+ * for a dump.
+ *
+ * Counters and timers add up over a frame and read as the total of the last
+ * finished frame. Gauges are either set to whatever they currently are, or
+ * sampled from a function whenever they're read.
+ */
+class Stats
+{
+ public:
+  static Stats &getInstance();
+
+  enum Kind
+  {
+    COUNTER,
+    GAUGE,
+    TIMER // milliseconds
+  };
+
+  // Returns the id of the stat with this name, registering it first if needed
+  int add(const std::string &name, Kind);
+  int addGauge(const std::string &name, std::function<double()> &&sample);
+
+  void count(int id, double n = 1.) { current[id] += n; }
+  void set(int id, double value) { current[id] = value; }
+  void addTime(int id, double ms) { current[id] += ms; }
+
+  double get(int id) const;
+  int getInt(int id) const { return static_cast<int>(get(id) + .5); }
+
+  // Closes the frame: counters and timers start over
+  void endFrame();
+
+  // Every stat as one JSON object, name to value
+  void dump(std::ostream&) const;
+
+  // Adds the time until it goes out of scope to a timer
+  class Timer
+  {
+   public:
+    explicit Timer(int i) : id(i), start(std::chrono::steady_clock::now()) {}
+    ~Timer() {
+      Stats::getInstance().addTime(id, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()); }
+    Timer(const Timer&) = delete;
+    Timer &operator=(const Timer&) = delete;
+   private:
+    int id;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  Stats(const Stats&) = delete;
+  Stats &operator=(const Stats&) = delete;
+
+ private:
+  Stats();
+
+  std::vector<std::string> names;
+  std::vector<Kind> kinds;
+  std::vector<double> current, last;
+  std::vector< std::function<double()> > samplers; // empty for pushed stats
+  std::unordered_map<std::string, int> ids;
+};
+
+#endif
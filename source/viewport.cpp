@@ -15,8 +15,8 @@ Viewport& Viewport::getInstance()
 Viewport::Viewport() : 
   cfg(GameConfig::getInstance()),
   viewPos(0, 0),
-  viewWidth(cfg["view"]["width"].toInt()), 
-  viewHeight(cfg["view"]["height"].toInt()),
+  viewWidth(cfg.get().view.width), 
+  viewHeight(cfg.get().view.height),
   zoomFactor(1.f),
   target(Vec2f(0,0))
 {
@@ -32,7 +32,7 @@ void Viewport::draw() const
 
   // Write name to screen
   //IoMod::getInstance().
-  IoMod::getInstance().writeText(GameConfig::getInstance()["author"].toStr(), 30, viewHeight - 56);
+  IoMod::getInstance().writeText(cfg.get().author, 30, viewHeight - 56);
 }
 
 void Viewport::update(float delta)
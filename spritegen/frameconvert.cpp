@@ -0,0 +1,71 @@
+// Converts '.frame' files from the old format to the current one, in place.
+//
+//   g++ -std=c++14 -O2 frameconvert.cpp -o frameconvert
+//   ./frameconvert ../source/assets/actor/*.frame ../source/assets/backdrops/*.frame
+//
+// Every file is read back after converting and checked against the original
+// before it gets replaced. Files already in the current format are skipped.
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+
+#include "../source/framefile.h"
+
+using namespace std;
+
+static vector<unsigned char> readFile(const string &name)
+{
+  ifstream fin(name, ios::in | ios::binary | ios::ate);
+  if (!fin.is_open()) throw string("Couldn't open " + name);
+  vector<unsigned char> bytes(static_cast<size_t>(fin.tellg()));
+  fin.seekg(0);
+  fin.read((char*)bytes.data(), bytes.size());
+  return bytes;
+}
+
+static bool sameFrames(const FrameFile &a, const FrameFile &b)
+{
+  if (a.frames.size() != b.frames.size() || a.vertices != b.vertices) return false;
+  for (size_t i = 0; i < a.frames.size(); i++) {
+    const FrameRecord &p = a.frames[i], &q = b.frames[i];
+    if (p.x != q.x || p.y != q.y || p.w != q.w || p.h != q.h || p.ox != q.ox || p.oy != q.oy ||
+	p.firstVertex != q.firstVertex || p.vertexCount != q.vertexCount)
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  int failed = 0;
+  for (int i = 1; i < argc; i++) {
+    string name = argv[i];
+    try {
+      vector<unsigned char> bytes = readFile(name);
+      if (FrameFile::isVersion2(bytes.data(), bytes.size())) {
+	cout << name << ": already converted" << endl;
+	continue;
+      }
+
+      FrameFile oldFile, newFile;
+      oldFile.decode(bytes.data(), bytes.size(), name);
+      vector<unsigned char> converted = oldFile.encode();
+      newFile.decode(converted.data(), converted.size(), name);
+      if (!sameFrames(oldFile, newFile)) throw string(name + ": converted file doesn't match the original");
+
+      ofstream fout(name, ios::out | ios::binary | ios::trunc);
+      fout.write((const char*)converted.data(), converted.size());
+      if (!fout) throw string("Couldn't write " + name);
+
+      cout << name << ": " << oldFile.frames.size() << " frames, " << oldFile.vertices.size()/2
+	   << " vertices, " << bytes.size() << " -> " << converted.size() << " bytes" << endl;
+    }
+    catch (const string &msg) {
+      cout << msg << endl;
+      failed++;
+    }
+  }
+  return failed > 0;
+}
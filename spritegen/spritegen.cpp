@@ -19,6 +19,7 @@
 #include <png.h>
 
 #include "../source/vector2.h"
+#include "../source/framefile.h"
 
 struct Image
 {
@@ -320,23 +321,21 @@ int main(void)
 
   cout << "Final size: " << size << "x" << size << endl;
 
-  ofstream frames(prefix + ".frame", ios::out | ios::binary);
-  unsigned short count = imgMap.size();
-  frames.write((const char*)&count, sizeof(unsigned short));
+  FrameFile frameFile;
   for (size_t i = 0; i < imgMap.size(); i++) {
     const auto &p = imgMap[i];
     shape &s = shapes[i];
-    frames.write((const char*)&p, sizeof(unsigned short)*4);
-    unsigned short centerx = p.ox-p.cx, centery = p.oy-p.cy;
-    frames.write((const char*)&centerx, sizeof(unsigned short));
-    frames.write((const char*)&centery, sizeof(unsigned short));
-
-    unsigned size = s.data.size();
-    frames.write((const char*)&size, sizeof(unsigned));
+    frameFile.frames.push_back({ p.x, p.y, p.w, p.h,
+	  static_cast<short>(p.ox-p.cx), static_cast<short>(p.oy-p.cy),
+	  static_cast<unsigned>(frameFile.vertices.size()/2), static_cast<unsigned>(s.data.size()) });
     for (vertex &v : s.data) {
-      frames.write((const char*)&v, sizeof(float) * 2);
+      frameFile.vertices.push_back(v.x);
+      frameFile.vertices.push_back(v.y);
     }
   }
+  std::vector<unsigned char> frameBytes = frameFile.encode();
+  ofstream frames(prefix + ".frame", ios::out | ios::binary);
+  frames.write((const char*)frameBytes.data(), frameBytes.size());
 
   newImage = new Image;
 